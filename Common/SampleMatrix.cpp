@@ -0,0 +1,175 @@
+#include "SampleMatrix.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char cacheMagic[8] = {'S', 'M', 'A', 'T', 'R', 'I', 'X', '1'};
+
+static bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '[' || c == ']';
+}
+
+SampleMatrix::SampleMatrix() : rows(0), columns(0), stride(0) {}
+
+SampleMatrix::SampleMatrix(std::size_t rows, std::size_t columns) : rows(0), columns(0), stride(0) {
+    this->allocate(rows, columns);
+    this->rows = rows;
+}
+
+void SampleMatrix::allocate(std::size_t rowCapacity, std::size_t columns) {
+    constexpr std::size_t perCacheLine = alignment / sizeof(double);
+
+    this->rows = 0;
+    this->columns = columns;
+    this->stride = (rowCapacity + perCacheLine - 1) / perCacheLine * perCacheLine;
+    this->data.assign(this->stride * columns, 0.0);
+}
+
+bool SampleMatrix::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return false;
+    }
+
+    this->allocate(0, 0);
+    std::size_t size = info.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char* begin = static_cast<const char*>(mapping);
+    const char* end = begin + size;
+
+    // Every sample takes at least one line, so the line count is enough capacity for all of them
+    std::size_t lineCount = std::count(begin, end, '\n') + 1;
+
+    std::vector<double> row;
+    std::size_t lineNumber = 0;
+    bool success = true;
+
+    for (const char* line = begin ; line < end ; ) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (lineEnd == nullptr) lineEnd = end;
+        lineNumber++;
+
+        row.clear();
+        const char* p = line;
+        while (p < lineEnd) {
+            if (isSeparator(*p)) {
+                p++;
+                continue;
+            }
+
+            // from_chars doesn't take a leading '+' like the stream parser did
+            if (*p == '+' && p + 1 < lineEnd && p[1] != '-') p++;
+
+            double value;
+            auto [next, ec] = std::from_chars(p, lineEnd, value);
+            if (ec != std::errc()) break;
+            row.push_back(value);
+            p = next;
+        }
+        line = lineEnd + 1;
+
+        if (row.empty()) continue;
+
+        if (this->columns == 0) {
+            this->allocate(lineCount, row.size());
+        } else if (row.size() != this->columns) {
+            std::cerr << path << ':' << lineNumber << ": expected " << this->columns << " values, got " << row.size() << '\n';
+            success = false;
+            break;
+        }
+
+        for (std::size_t c = 0 ; c < this->columns ; c++) {
+            this->data[c * this->stride + this->rows] = row[c];
+        }
+        this->rows++;
+    }
+
+    munmap(mapping, size);
+    return success;
+}
+
+bool SampleMatrix::load(const std::string& path, const std::string& cachePath) {
+    std::error_code textError;
+    std::error_code cacheError;
+    auto textTime = std::filesystem::last_write_time(path, textError);
+    auto cacheTime = std::filesystem::last_write_time(cachePath, cacheError);
+
+    if (!cacheError && (textError || cacheTime >= textTime) && this->loadCache(cachePath)) return true;
+
+    if (!this->load(path)) return false;
+    if (!this->saveCache(cachePath)) {
+        std::cerr << "Failed to write cache file: " << cachePath << '\n';
+    }
+
+    return true;
+}
+
+bool SampleMatrix::loadCache(const std::string& cachePath) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    char magic[sizeof(cacheMagic)];
+    std::uint64_t rows;
+    std::uint64_t columns;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    file.read(reinterpret_cast<char*>(&columns), sizeof(columns));
+    if (!file || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0) return false;
+
+    // A truncated or otherwise damaged cache has to be rejected before it's header is trusted for the allocation
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(cachePath, error);
+    std::uintmax_t header = sizeof(cacheMagic) + sizeof(rows) + sizeof(columns);
+    if (error || size < header || (size - header) % sizeof(double) != 0) return false;
+    std::uintmax_t values = (size - header) / sizeof(double);
+    if (columns == 0 ? rows != 0 || values != 0 : values % columns != 0 || values / columns != rows) return false;
+
+    this->allocate(rows, columns);
+    for (std::size_t c = 0 ; c < columns ; c++) {
+        file.read(reinterpret_cast<char*>(this->column(c)), rows * sizeof(double));
+    }
+    if (!file) {
+        this->allocate(0, 0);
+        return false;
+    }
+
+    this->rows = rows;
+    return true;
+}
+
+bool SampleMatrix::saveCache(const std::string& cachePath) const {
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    std::uint64_t rows = this->rows;
+    std::uint64_t columns = this->columns;
+    file.write(cacheMagic, sizeof(cacheMagic));
+    file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    file.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+    for (std::size_t c = 0 ; c < this->columns ; c++) {
+        file.write(reinterpret_cast<const char*>(this->column(c)), this->rows * sizeof(double));
+    }
+
+    return static_cast<bool>(file);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {return true;}
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {return false;}
+};
+
+/*
+    Column-major (SoA) table of samples
+    Every column starts on a cache line and is padded to a whole number of cache lines,
+    so a column can be handed to a tight loop as a plain aligned array
+*/
+class SampleMatrix {
+    public:
+        static constexpr std::size_t alignment = 64;
+
+    private:
+        std::size_t rows;
+        std::size_t columns;
+        std::size_t stride;     // Doubles between the starts of two neighbouring columns
+        std::vector<double, AlignedAllocator<double, alignment>> data;
+
+        void allocate(std::size_t rowCapacity, std::size_t columns);
+
+    public:
+        SampleMatrix();
+        SampleMatrix(std::size_t rows, std::size_t columns);
+
+        /*
+            Parses a text file where every line holds one sample
+            Numbers may be separated by whitespace, ',', '[' or ']'; a line is read until the first token that isn't a number,
+            so comment lines (e.g. starting with '#') and empty lines are skipped
+        */
+        bool load(const std::string& path);
+
+        // Same as load(path), but reuses the binary cache if it is newer than the text file and refreshes it otherwise
+        bool load(const std::string& path, const std::string& cachePath);
+
+        // Fails if the file size doesn't match the rows and columns in it's header, load(path, cachePath) then rebuilds the cache
+        bool loadCache(const std::string& cachePath);
+        bool saveCache(const std::string& cachePath) const;
+
+        std::size_t getRows() const {return rows;}
+        std::size_t getColumns() const {return columns;}
+        std::size_t getStride() const {return stride;}
+
+        double* column(std::size_t index) {return data.data() + index * stride;}
+        const double* column(std::size_t index) const {return data.data() + index * stride;}
+
+        double& at(std::size_t row, std::size_t col) {return data[col * stride + row];}
+        double at(std::size_t row, std::size_t col) const {return data[col * stride + row];}
+};
\ No newline at end of file
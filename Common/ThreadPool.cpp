@@ -0,0 +1,68 @@
+#include "ThreadPool.h"
+#include <atomic>
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = 1;
+    for (std::size_t i = 1 ; i < threads ; i++) {
+        this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread& worker : this->workers) worker.join();
+}
+
+void ThreadPool::workerLoop(std::size_t worker) {
+    std::size_t seen = 0;
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->wake.wait(lock, [&] {return this->stopping || this->generation != seen;});
+        if (this->stopping) return;
+        seen = this->generation;
+
+        const std::function<void(std::size_t)>* job = this->job;
+        lock.unlock();
+        (*job)(worker);
+        lock.lock();
+
+        if (--this->pending == 0) this->done.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t index, std::size_t worker)>& task) {
+    // The loop's state is captured through a single pointer, which std::function stores without allocating
+    struct Loop {
+        std::atomic<std::size_t> next = 0;
+        std::size_t count;
+        const std::function<void(std::size_t, std::size_t)>* task;
+    } loop{0, count, &task};
+    std::function<void(std::size_t)> work = [state = &loop](std::size_t worker) {
+        for (std::size_t i = state->next.fetch_add(1) ; i < state->count ; i = state->next.fetch_add(1)) {
+            (*state->task)(i, worker);
+        }
+    };
+
+    // Not worth waking anyone up for
+    if (this->workers.empty() || count <= 1) {
+        work(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &work;
+        this->pending = this->workers.size();
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [&] {return this->pending == 0;});
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed set of worker threads for data-parallel loops
+    The calling thread takes part in every loop as worker 0, so a pool of size 1 runs everything inline
+*/
+class ThreadPool {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(std::size_t)>* job = nullptr;  // Argument is the worker index
+        std::size_t generation = 0;     // Incremented for every job so sleeping workers can tell a new one apart
+        std::size_t pending = 0;        // Workers that haven't finished the current job
+        bool stopping = false;
+
+        void workerLoop(std::size_t worker);
+
+    public:
+        explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t size() const {return workers.size() + 1;}
+
+        // Calls task(index, worker) for every index in [0, count); indices are handed out one by one to whichever worker is free
+        void parallelFor(std::size_t count, const std::function<void(std::size_t index, std::size_t worker)>& task);
+};
\ No newline at end of file
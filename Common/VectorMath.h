@@ -0,0 +1,119 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+
+/*
+    sin, cos, exp and log10 written without branches or calls so loops over samples vectorise, the std functions are called one value at a time
+    They are accurate to a few ulp, but only inside the limits below (log10 needs a positive normal argument), callers check their
+    arguments and use the std functions otherwise. The functions are declared simd so the loops vectorise even if they aren't inlined
+*/
+struct VectorMath {
+    static constexpr double shifter = 0x1.8p52;     // Adding it rounds to an integer, which then sits in the low bits of the double
+    static constexpr double trigLimit = 1e5;
+    static constexpr double expLimit = 708.0;
+
+    // sin(x) for quadrant 0, cos(x) for quadrant 1
+    #pragma omp declare simd uniform(quadrant)
+    static double trig(double x, std::uint64_t quadrant) {
+        constexpr double twoOverPi = 0x1.45f306dc9c883p-1;
+        // pi / 2 split in three parts (as in fdlibm), the first has 33 bits so q * pio2_1 is exact for |x| <= trigLimit
+        constexpr double pio2_1 = 1.57079632673412561417e+00;
+        constexpr double pio2_2 = 6.07710050630396597660e-11;
+        constexpr double pio2_3 = 2.02226624871116645580e-21;
+
+        // x = q * pi / 2 + r with |r| <= pi / 4
+        double shifted = x * twoOverPi + shifter;
+        double q = shifted - shifter;
+        quadrant += std::bit_cast<std::uint64_t>(shifted);
+        double r = ((x - q * pio2_1) - q * pio2_2) - q * pio2_3;
+        double z = r * r;
+
+        // fdlibm's __kernel_sin and __kernel_cos polynomials
+        double s = 1.58969099521155010221e-10;
+        s = s * z - 2.50507602534068634195e-08;
+        s = s * z + 2.75573137070700676789e-06;
+        s = s * z - 1.98412698298579493134e-04;
+        s = s * z + 8.33333333332248946124e-03;
+        s = s * z - 1.66666666666666324348e-01;
+        double sinR = r + r * z * s;
+
+        double c = -1.13596475577881948265e-11;
+        c = c * z + 2.08757232129817482790e-09;
+        c = c * z - 2.75573143513906633035e-07;
+        c = c * z + 2.48015872894767294178e-05;
+        c = c * z - 1.38888888888741095749e-03;
+        c = c * z + 4.16666666666666019037e-02;
+        double cosR = 1.0 - 0.5 * z + z * z * c;
+
+        // sin(r), cos(r), -sin(r), -cos(r) for quadrants 0 to 3
+        double value = (quadrant & 1) ? cosR : sinR;
+        return (quadrant & 2) ? -value : value;
+    }
+
+    #pragma omp declare simd
+    static double sin(double x) {
+        return trig(x, 0);
+    }
+
+    #pragma omp declare simd
+    static double cos(double x) {
+        return trig(x, 1);
+    }
+
+    #pragma omp declare simd
+    static double exp(double x) {
+        constexpr double log2e = 0x1.71547652b82fep0;
+        constexpr double ln2Hi = 0x1.62e42fefa3800p-1;
+        constexpr double ln2Lo = 0x1.ef35793c76730p-45;
+
+        // x = k * ln2 + r with |r| <= ln2 / 2
+        double shifted = x * log2e + shifter;
+        double k = shifted - shifter;
+        double r = (x - k * ln2Hi) - k * ln2Lo;
+
+        // Taylor series to degree 13, the remainder is below 1e-17
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        // 2^k built directly in the exponent bits
+        return p * std::bit_cast<double>((std::bit_cast<std::uint64_t>(shifted) + 1023) << 52);
+    }
+
+    // For positive normal x
+    #pragma omp declare simd
+    static double log10(double x) {
+        constexpr std::uint64_t sqrtHalf = 0x3fe6a09e667f3bcd;
+        constexpr std::uint64_t bias = 1024ull << 52;
+        constexpr double ln2Hi = 6.93147180369123816490e-01;
+        constexpr double ln2Lo = 1.90821492927058770002e-10;
+        constexpr double log10e = 0x1.bcb7b1526e50ep-2;
+
+        // x = 2^k * m with m in [sqrt(2) / 2, sqrt(2)), k is read through the shifter so no integer conversion is needed
+        std::uint64_t bits = std::bit_cast<std::uint64_t>(x);
+        std::uint64_t u = bits - sqrtHalf + bias;
+        double k = std::bit_cast<double>((u >> 52) | 0x4330000000000000) - (0x1p52 + 1024);
+        double f = std::bit_cast<double>(bits - (u & 0xfff0000000000000) + bias) - 1.0;
+
+        // fdlibm's __ieee754_log
+        double s = f / (2.0 + f);
+        double z = s * s;
+        double w = z * z;
+        double t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+        double t2 = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+        double hfsq = 0.5 * f * f;
+        double ln = k * ln2Hi - ((hfsq - (s * (hfsq + t1 + t2) + k * ln2Lo)) - f);
+        return ln * log10e;
+    }
+};
\ No newline at end of file
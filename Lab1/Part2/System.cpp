@@ -1,14 +1,22 @@
 #include "System.h"
 #include <cmath>
+#include <numbers>
 
-System::System(std::vector<std::vector<double>> samples) : samples(samples) {}
+System::System(SampleMatrix samples) : samples(std::move(samples)) {}
 
 // Returns the mean squares error
 double System::getOptimizationParameter(std::vector<double> coef) {
+    const double* x1 = samples.column(0);
+    const double* x2 = samples.column(1);
+    const double* x3 = samples.column(2);
+    const double* x4 = samples.column(3);
+    const double* x5 = samples.column(4);
+    const double* y = samples.column(5);
+
     double error = 0.0;
-    for (std::vector<double> sample : samples) {
-        double output = coef[0] * sample[0] + coef[1] * std::pow(sample[0], 3) * sample[1] + coef[2] * std::pow(std::numbers::e, coef[3] * sample[2]) * (1 + std::cos(coef[4] * sample[3])) + coef[5] * sample[3] * std::pow(sample[4], 2);
-        error += std::pow(output - sample[5], 2);
+    for (std::size_t i = 0 ; i < samples.getRows() ; i++) {
+        double output = coef[0] * x1[i] + coef[1] * std::pow(x1[i], 3) * x2[i] + coef[2] * std::pow(std::numbers::e, coef[3] * x3[i]) * (1 + std::cos(coef[4] * x4[i])) + coef[5] * x4[i] * std::pow(x5[i], 2);
+        error += std::pow(output - y[i], 2);
     }
     return std::sqrt(error);
 }
\ No newline at end of file
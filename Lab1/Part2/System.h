@@ -1,12 +1,13 @@
 #pragma once
 #include "ISystem.h"
+#include "../../Common/SampleMatrix.h"
 
 class System : public ISystem {
     private:
-        std::vector<std::vector<double>> samples;
+        SampleMatrix samples;   // Columns x1, x2, x3, x4, x5, y
 
     public:
-        System(std::vector<std::vector<double>> samples);
+        System(SampleMatrix samples);
 
         // Returns the mean squares error
         double getOptimizationParameter(std::vector<double> coef);
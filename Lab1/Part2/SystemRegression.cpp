@@ -3,8 +3,6 @@
 #include <vector>
 #include <cmath>
 #include <numbers>
-#include <sstream>
-#include <fstream>
 #include "System.h"
 
 std::pair<bool, std::string> checkOption(char* argv[], int argc, std::string option) {
@@ -30,37 +28,16 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    std::ifstream file(argv[1]);
-    if (!file.is_open()) {
+    std::pair<bool, std::string> option = checkOption(argv, argc, "-cache");
+
+    SampleMatrix data;
+    bool loaded = option.first ? data.load(argv[1], option.second) : data.load(argv[1]);
+    if (!loaded) {
         std::cerr << "Error opening file: " << argv[1] << '\n';
         return 1;
     }
 
-    std::vector<std::vector<double>> data;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::vector<double> row;
-        std::string cleaned;
-
-        for (char c : line) {
-            if (c != '[' && c != ']' && c != ',') cleaned += c;
-        }
-
-        std::stringstream ss(cleaned);
-        double val;
-        while (ss >> val) {
-            row.push_back(val);
-        }
-        
-        if (!row.empty()) {
-            data.push_back(row);
-        }
-    }
-
-    file.close();
-
-    System system = System(data);
+    System system = System(std::move(data));
 
     // bool maximize, int numOfVariables, int (*function)(std::vector<double>), int maxIterations, double initialTemp, double alpha);
 
@@ -70,8 +47,6 @@ int main(int argc, char* argv[]) {
     double alpha = 0.95;
     double neighbourMaxChange = 0.5;
 
-    std::pair<bool, std::string> option;
-
     option = checkOption(argv, argc, "-maxIter");
     if (option.first) maxIterations = std::stoi(option.second);
 
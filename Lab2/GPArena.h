@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    Bump allocator for GP trees
+    Objects are never destroyed one by one, reset() releases everything at once and keeps the chunks for reuse,
+    so only trivially destructible types can be stored
+*/
+class GPArena {
+    public:
+        static constexpr std::size_t chunkSize = 1 << 16;
+
+    private:
+        std::vector<std::unique_ptr<std::byte[]>> chunks;
+        std::size_t nextChunk = 0;      // Index of the chunk to use when the current one runs out
+        std::byte* cursor = nullptr;    // First free byte of the current chunk
+        std::byte* limit = nullptr;     // End of the current chunk
+        std::size_t allocations = 0;    // Since the last reset
+
+    public:
+        GPArena() = default;
+        GPArena(const GPArena&) = delete;
+        GPArena& operator=(const GPArena&) = delete;
+        GPArena(GPArena&&) = default;
+        GPArena& operator=(GPArena&&) = default;
+
+        void* allocate(std::size_t size, std::size_t alignment) {
+            std::uintptr_t start = (reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+            if (cursor == nullptr || start + size > reinterpret_cast<std::uintptr_t>(limit)) {
+                if (size > chunkSize) throw std::bad_alloc();
+                if (nextChunk == chunks.size()) chunks.push_back(std::make_unique<std::byte[]>(chunkSize));
+                cursor = chunks[nextChunk].get();
+                limit = cursor + chunkSize;
+                nextChunk++;
+                start = reinterpret_cast<std::uintptr_t>(cursor);   // Chunks are aligned for any fundamental type
+            }
+
+            cursor = reinterpret_cast<std::byte*>(start + size);
+            allocations++;
+            return reinterpret_cast<void*>(start);
+        }
+
+        template <typename U, typename... Args>
+        U* create(Args&&... args) {
+            static_assert(std::is_trivially_destructible_v<U>, "GPArena never runs destructors");
+            return new (allocate(sizeof(U), alignof(U))) U(std::forward<Args>(args)...);
+        }
+
+        // Value-initialised array
+        template <typename U>
+        U* createArray(std::size_t count) {
+            static_assert(std::is_trivially_destructible_v<U>, "GPArena never runs destructors");
+            if (count == 0) return nullptr;
+            return new (allocate(count * sizeof(U), alignof(U))) U[count]();
+        }
+
+        void reset() {
+            nextChunk = 0;
+            cursor = nullptr;
+            limit = nullptr;
+            allocations = 0;
+        }
+
+        std::size_t getAllocations() const {
+            return allocations;
+        }
+
+        std::size_t getReservedBytes() const {
+            return chunks.size() * chunkSize;
+        }
+};
\ No newline at end of file
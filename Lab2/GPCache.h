@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+    LRU cache of subtree outputs over the whole training set, keyed by the subtree's structural hash
+
+    The cache is only modified between parallel evaluations:
+    before one, request() is called for the subtrees of every scheduled tree, which pins what's found and reserves room for the rest;
+    while the trees are evaluated, compiled programs read the ready entries and fill the ones their tree reserved;
+    afterwards commit() publishes the filled entries. Entries pinned by the current batch are never evicted
+*/
+template <typename T>
+class GPSubtreeCache {
+    public:
+        struct Entry {
+            std::uint64_t hash;
+            std::vector<T> outputs;     // One value per sample
+            const void* owner;          // Tree that fills outputs during the current batch
+            std::size_t batch;          // Last batch that used the entry
+            bool ready;
+        };
+
+    private:
+        std::list<Entry> entries;      // Most recently used first
+        std::unordered_map<std::uint64_t, typename std::list<Entry>::iterator> index;
+        std::vector<Entry*> reserved;  // Entries filled by the current batch
+
+        std::size_t samples;
+        std::size_t maxBytes;
+        std::size_t usedBytes = 0;
+        std::size_t minSubtreeSize;
+        std::size_t batch = 0;
+
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+
+        std::size_t entryBytes() const {
+            return sizeof(Entry) + this->samples * sizeof(T) + 4 * sizeof(void*);    // Plus the list and hash map bookkeeping
+        }
+
+        bool makeRoom() {
+            while (this->usedBytes + this->entryBytes() > this->maxBytes) {
+                if (this->entries.empty() || this->entries.back().batch == this->batch) return false;
+                this->index.erase(this->entries.back().hash);
+                this->entries.pop_back();
+                this->usedBytes -= this->entryBytes();
+            }
+            return true;
+        }
+
+    public:
+        // Subtrees smaller than minSubtreeSize nodes aren't worth a lookup
+        GPSubtreeCache(std::size_t samples, std::size_t maxBytes, std::size_t minSubtreeSize = 2) :
+        samples(samples),
+        maxBytes(maxBytes),
+        minSubtreeSize(minSubtreeSize) {}
+
+        GPSubtreeCache(const GPSubtreeCache&) = delete;
+        GPSubtreeCache& operator=(const GPSubtreeCache&) = delete;
+
+        void beginBatch() {
+            this->batch++;
+        }
+
+        /*
+            Returns true if the subtree's outputs are ready, so it's children don't have to be requested
+            Otherwise the entry is reserved for owner (if there's room and nobody else in this batch did it already)
+        */
+        bool request(std::uint64_t hash, std::size_t subtreeSize, const void* owner) {
+            if (subtreeSize < this->minSubtreeSize) return false;
+
+            auto it = this->index.find(hash);
+            if (it != this->index.end()) {
+                this->entries.splice(this->entries.begin(), this->entries, it->second);
+                Entry& entry = *it->second;
+                entry.batch = this->batch;
+                if (entry.ready) {
+                    this->hits++;
+                    return true;
+                }
+                this->misses++;
+                return false;
+            }
+
+            this->misses++;
+            if (!this->makeRoom()) return false;
+
+            this->entries.push_front({hash, std::vector<T>(this->samples), owner, this->batch, false});
+            this->index[hash] = this->entries.begin();
+            this->reserved.push_back(&this->entries.front());
+            this->usedBytes += this->entryBytes();
+            return false;
+        }
+
+        // Read-only, safe to call from several threads while the cache isn't modified
+        const Entry* find(std::uint64_t hash, std::size_t subtreeSize) const {
+            if (subtreeSize < this->minSubtreeSize) return nullptr;
+
+            auto it = this->index.find(hash);
+            return it == this->index.end() ? nullptr : &*it->second;
+        }
+
+        // Every reserved entry must have been filled over all samples by now, except the ones owned by incomplete trees (whose evaluation was aborted)
+        void commit(const std::unordered_set<const void*>& incomplete = {}) {
+            for (Entry* entry : this->reserved) {
+                if (incomplete.contains(entry->owner)) {
+                    auto it = this->index.find(entry->hash);
+                    this->entries.erase(it->second);
+                    this->index.erase(it);
+                    this->usedBytes -= this->entryBytes();
+                    continue;
+                }
+                entry->ready = true;
+                entry->owner = nullptr;
+            }
+            this->reserved.clear();
+        }
+
+        std::size_t getHits() const {return hits;}
+        std::size_t getMisses() const {return misses;}
+        std::size_t getUsedBytes() const {return usedBytes;}
+        std::size_t getEntries() const {return entries.size();}
+
+        double getHitRate() const {
+            return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+        }
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+#include "../Common/VectorMath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <span>
+#include <type_traits>
+
+/*
+    Element-wise primitives over blocks of samples, used by GPProgram::evaluateBatch
+    Results are written into the first operand. Every loop is branch-free (protected operators compute both sides and select)
+    so the compiler can vectorise it. sin, cos, exp and log use the VectorMath polynomials instead of the scalar libm calls, they're accurate
+    to a few ulp and computed in double for float too. A block with any argument outside their range goes through the std functions
+*/
+struct GPKernels {
+    template <typename T>
+    static void add(std::span<T> a, std::span<const T> b) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = a[i] + b[i];
+    }
+
+    template <typename T>
+    static void sub(std::span<T> a, std::span<const T> b) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = a[i] - b[i];
+    }
+
+    template <typename T>
+    static void mul(std::span<T> a, std::span<const T> b) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = a[i] * b[i];
+    }
+
+    // Protected: x / 0 = 1
+    template <typename T>
+    static void div(std::span<T> a, std::span<const T> b) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) {
+            T quotient = a[i] / b[i];
+            a[i] = b[i] == 0 ? T(1) : quotient;
+        }
+    }
+
+    template <typename T>
+    static void sin(std::span<T> a) {
+        int outside = 0;
+        #pragma omp simd reduction(|:outside)
+        for (std::size_t i = 0 ; i < a.size() ; i++) outside |= !(std::abs(a[i]) <= T(VectorMath::trigLimit));   // Also catches NaN
+
+        if (outside) {
+            for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = std::sin(a[i]);
+            return;
+        }
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = static_cast<T>(VectorMath::sin(a[i]));
+    }
+
+    template <typename T>
+    static void cos(std::span<T> a) {
+        int outside = 0;
+        #pragma omp simd reduction(|:outside)
+        for (std::size_t i = 0 ; i < a.size() ; i++) outside |= !(std::abs(a[i]) <= T(VectorMath::trigLimit));
+
+        if (outside) {
+            for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = std::cos(a[i]);
+            return;
+        }
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = static_cast<T>(VectorMath::cos(a[i]));
+    }
+
+    // Protected: sqrt(x < 0) = 1
+    template <typename T>
+    static void sqrt(std::span<T> a) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) {
+            T root = std::sqrt(a[i]);
+            a[i] = a[i] < 0 ? T(1) : root;
+        }
+    }
+
+    // Protected: log10(x <= 0) = 1
+    template <typename T>
+    static void log(std::span<T> a) {
+        // GCC doesn't if-convert the protection below when floats are mixed with the double polynomial, so floats go through a double block
+        if constexpr (!std::is_same_v<T, double>) {
+            constexpr std::size_t blockSize = 64;
+            double block[blockSize];
+            for (std::size_t first = 0 ; first < a.size() ; first += blockSize) {
+                std::size_t count = std::min(blockSize, a.size() - first);
+                std::copy_n(a.data() + first, count, block);
+                log(std::span<double>(block, count));
+                std::copy_n(block, count, a.data() + first);
+            }
+            return;
+        }
+
+        // Non-positive arguments are protected anyway, only NaN, infinity and subnormals (in double) need the std function
+        int outside = 0;
+        #pragma omp simd reduction(|:outside)
+        for (std::size_t i = 0 ; i < a.size() ; i++) {
+            double x = a[i];
+            outside |= !(x <= 0) && !(x >= DBL_MIN && x <= DBL_MAX);
+        }
+
+        if (outside) {
+            for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = a[i] <= 0 ? T(1) : std::log10(a[i]);
+            return;
+        }
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) {
+            T logarithm = static_cast<T>(VectorMath::log10(a[i] <= 0 ? 1.0 : a[i]));
+            a[i] = a[i] <= 0 ? T(1) : logarithm;
+        }
+    }
+
+    template <typename T>
+    static void exp(std::span<T> a) {
+        int outside = 0;
+        #pragma omp simd reduction(|:outside)
+        for (std::size_t i = 0 ; i < a.size() ; i++) outside |= !(std::abs(a[i]) <= T(VectorMath::expLimit));
+
+        if (outside) {
+            for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = std::exp(a[i]);
+            return;
+        }
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = static_cast<T>(VectorMath::exp(a[i]));
+    }
+};
\ No newline at end of file
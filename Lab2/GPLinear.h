@@ -0,0 +1,628 @@
+#pragma once
+#include "GPTree.h"
+
+// Tree stored as a contiguous prefix-order array of genes, every gene knows the extent of it's subtree
+template <typename T, typename Context>
+class GPLinearTree {
+    private:
+        std::vector<GPGene<T, Context>> genes;
+        double penalty = -1;
+        bool overThreshold = false;     // Same as GPNode::isOverThreshold
+
+        // Fixes extents, depths and hashes on the path from index down to target after the subtree at target changed size by delta
+        void updatePath(std::size_t index, std::size_t target, std::ptrdiff_t delta) {
+            if (index == target) return;
+
+            std::uint32_t maxDepth = 0;
+            GPHash hash(genes[index].oper, genes[index].value);
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                bool onPath = child <= target && target < child + genes[child].subtreeSize;
+                if (onPath) this->updatePath(child, target, delta);
+                maxDepth = std::max(maxDepth, genes[child].subtreeDepth);
+                hash.add(genes[child].hash);
+                child += genes[child].subtreeSize;
+            }
+
+            genes[index].subtreeSize += delta;
+            genes[index].subtreeDepth = maxDepth + 1;
+            genes[index].hash = hash.get();
+        }
+
+        std::string toString(std::size_t index) const {
+            const GPGene<T, Context>& gene = genes[index];
+            switch (gene.oper->arity) {
+                case 0:
+                    if (gene.oper->opcode == GPOpcode::CONST) return std::to_string(gene.value);
+                    else return gene.oper->symbol;
+                case 1:
+                    return gene.oper->symbol + "(" + this->toString(index + 1) + ")";
+                case 2: {
+                    std::size_t second = index + 1 + genes[index + 1].subtreeSize;
+                    return "(" + this->toString(index + 1) + gene.oper->symbol + this->toString(second) + ")";
+                }
+            }
+
+            return "";
+        }
+
+    public:
+        std::vector<GPGene<T, Context>>& getGenes() {
+            return genes;
+        }
+
+        std::span<const GPGene<T, Context>> getGenes() const {
+            return genes;
+        }
+
+        // The subtree rooted at index
+        std::span<const GPGene<T, Context>> getSubtree(std::size_t index) const {
+            return std::span<const GPGene<T, Context>>(genes.data() + index, genes[index].subtreeSize);
+        }
+
+        std::size_t getSubtreeSize(std::size_t index = 0) const {
+            return genes[index].subtreeSize;
+        }
+
+        std::size_t getSubtreeDepth(std::size_t index = 0) const {
+            return genes[index].subtreeDepth;
+        }
+
+        std::uint64_t getHash() const {
+            return genes[0].hash;
+        }
+
+        double getPenalty() const {
+            return penalty;
+        }
+
+        void setPenalty(double penalty, bool overThreshold = false) {
+            this->penalty = penalty;
+            this->overThreshold = overThreshold;
+        }
+
+        bool isOverThreshold() const {
+            return overThreshold;
+        }
+
+        // After gene values changed in place, children come after their parent so they are hashed first
+        void recalculateHashes() {
+            for (std::size_t index = genes.size() ; index-- > 0 ; ) {
+                GPHash hash(genes[index].oper, genes[index].value);
+                std::size_t child = index + 1;
+                for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                    hash.add(genes[child].hash);
+                    child += genes[child].subtreeSize;
+                }
+                genes[index].hash = hash.get();
+            }
+        }
+
+        // Never returns the root, same as GPNode::getRandomNode
+        std::size_t getRandomIndex(std::mt19937& rng) const {
+            std::uniform_int_distribution<std::size_t> dist(1, genes.size() - 1);
+            return dist(rng);
+        }
+
+        // Becomes a copy of base with the subtree at index replaced by the given one
+        void splice(const GPLinearTree<T, Context>& base, std::size_t index, std::span<const GPGene<T, Context>> subtree) {
+            std::size_t removedEnd = index + base.genes[index].subtreeSize;
+
+            genes.clear();
+            genes.insert(genes.end(), base.genes.begin(), base.genes.begin() + index);
+            genes.insert(genes.end(), subtree.begin(), subtree.end());
+            genes.insert(genes.end(), base.genes.begin() + removedEnd, base.genes.end());
+
+            this->updatePath(0, index, static_cast<std::ptrdiff_t>(subtree.size()) - static_cast<std::ptrdiff_t>(removedEnd - index));
+            penalty = -1;
+            overThreshold = false;
+        }
+
+        std::string toString() const {
+            return this->toString(0);
+        }
+};
+
+/*
+    GP over linear trees
+    Same algorithm as GP, but variation copies gene spans instead of cloning and relinking nodes,
+    and the population buffers keep their capacity between generations
+*/
+template <typename T, typename Context>
+class LinearGP {
+    private:
+        std::vector<GPLinearTree<T, Context>> population;
+        std::vector<GPLinearTree<T, Context>> nextPopulation;   // Reused buffer for newGeneration
+        GPLinearTree<T, Context> spare;     // Takes the second crossover child when the new population is already full
+        std::size_t populationSize;
+
+        GPGenerator<T, Context> generator;
+        std::vector<GPGene<T, Context>> genes;  // Scratch buffer for generated subtrees
+
+        std::size_t costEvaluations;
+        std::size_t maxTreeDepth;
+        std::size_t maxTreeNodes;
+        std::size_t tournamentSize;
+        std::size_t elitism;
+        double pClone;
+        double pMutate;
+        double pCross;
+
+        IPenalty<T, Context>* penalty;
+
+        // Same two-phase evaluation as GP
+        ThreadPool pool;
+        std::vector<GPProgram<T, Context>> programs;
+        std::vector<GPLinearTree<T, Context>*> unevaluated;
+
+        std::vector<std::size_t> competitors;
+
+        std::unique_ptr<GPSubtreeCache<T>> cache;
+
+        // Duplicate detection as in GP, scheduled twins point into nextPopulation
+        std::unordered_map<std::uint64_t, std::pair<double, bool>> parentPenalties;
+        std::unordered_map<std::uint64_t, GPLinearTree<T, Context>*> scheduled;
+        std::vector<std::pair<GPLinearTree<T, Context>*, GPLinearTree<T, Context>*>> twins;
+        bool rejectDuplicates = false;
+        std::size_t rejectedThisGeneration = 0;
+        std::size_t duplicates = 0;
+        std::size_t rejected = 0;
+
+        // Early abort as in GP
+        std::size_t earlyAbort = 0;
+        double cutoff = std::numeric_limits<double>::infinity();
+        std::vector<char> aborted;
+        std::size_t abortedEvaluations = 0;
+
+        // Constant tuning as in GP
+        std::size_t tunedIndividuals = 0;
+        std::size_t tuningInterval = 1;
+        std::size_t tuningPasses = 0;
+        std::size_t generationsSinceTuning = 0;
+        std::vector<GPConstantTuner<T, Context>> tuners;
+        std::vector<std::vector<GPGene<T, Context>>> tunedGenes;
+        std::vector<GPLinearTree<T, Context>*> tuned;
+        std::vector<std::size_t> tuningEvaluations;
+        std::vector<char> tuningImproved;
+        std::size_t improvedByTuning = 0;
+
+        GPSelection selection = GPSelection::PENALTY;
+        std::vector<GPLinearTree<T, Context>> sortScratch;
+        std::vector<double> penalties;
+
+        // Telemetry as in GP
+        std::function<void(const GPGenerationStats&)> telemetry;
+        GPPhaseTimer timer;
+        GPGenerationStats stats;
+        std::size_t generation = 0;
+
+        Context context;
+
+        std::mt19937 rng;
+        std::uniform_real_distribution<double> probDist;
+
+        void requestCached(const GPGene<T, Context>* genes, std::size_t index) {
+            if (this->cache->request(genes[index].hash, genes[index].subtreeSize, genes)) return;
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                this->requestCached(genes, child);
+                child += genes[child].subtreeSize;
+            }
+        }
+
+        bool schedule(GPLinearTree<T, Context>* tree, bool mayReject) {
+            std::uint64_t hash = tree->getHash();
+            auto parent = this->parentPenalties.find(hash);
+            auto twin = this->scheduled.find(hash);
+            bool duplicate = parent != this->parentPenalties.end() || twin != this->scheduled.end();
+
+            if (duplicate && mayReject && this->rejectDuplicates && this->rejectedThisGeneration < this->populationSize) {
+                this->rejectedThisGeneration++;
+                this->rejected++;
+                return false;
+            }
+
+            if (parent != this->parentPenalties.end()) {
+                tree->setPenalty(parent->second.first, parent->second.second);
+                this->duplicates++;
+            } else if (twin != this->scheduled.end()) {
+                this->twins.push_back(std::make_pair(tree, twin->second));
+                this->duplicates++;
+            } else {
+                this->scheduled.emplace(hash, tree);
+                this->unevaluated.push_back(tree);
+            }
+            return true;
+        }
+
+        void evaluateScheduled() {
+            if (this->cache) {
+                this->cache->beginBatch();
+                for (GPLinearTree<T, Context>* tree : this->unevaluated) {
+                    this->requestCached(tree->getGenes().data(), 0);
+                }
+            }
+
+            this->penalty->prepare();
+            this->aborted.assign(this->unevaluated.size(), false);
+            this->pool.parallelFor(this->unevaluated.size(), [this](std::size_t index, std::size_t worker) {
+                GPProgram<T, Context>& program = this->programs[worker];
+                GPLinearTree<T, Context>* tree = this->unevaluated[index];
+                program.compile(tree->getGenes(), this->cache.get());
+                bool aborted;
+                double penalty = this->penalty->calculate(this->context, program, this->cutoff, aborted);
+                this->aborted[index] = aborted;
+                tree->setPenalty(penalty, aborted);
+            });
+
+            // Cache entries are owned by the gene arrays
+            std::unordered_set<const void*> incomplete;
+            for (std::size_t i = 0 ; i < this->unevaluated.size() ; i++) {
+                if (this->aborted[i]) incomplete.insert(this->unevaluated[i]->getGenes().data());
+            }
+            if (this->cache) this->cache->commit(incomplete);
+            this->abortedEvaluations += incomplete.size();
+            this->costEvaluations += this->unevaluated.size();
+            this->unevaluated.clear();
+
+            for (const auto& twin : this->twins) {
+                twin.first->setPenalty(twin.second->getPenalty(), twin.second->isOverThreshold());
+            }
+            this->twins.clear();
+            this->scheduled.clear();
+        }
+
+        void mutate(const GPLinearTree<T, Context>& tree, GPLinearTree<T, Context>& child) {
+            std::size_t index = tree.getRandomIndex(this->rng);
+
+            this->genes.clear();
+            this->generator.grow(
+                this->genes,
+                this->maxTreeDepth - tree.getSubtreeDepth() + tree.getSubtreeDepth(index),
+                this->maxTreeNodes - tree.getSubtreeSize() + tree.getSubtreeSize(index),
+                this->rng
+            );
+
+            child.splice(tree, index, this->genes);
+        }
+
+        // Returns how many of the two children are valid (exceeded max depth or node count otherwise), the valid ones come first
+        std::size_t cross(const GPLinearTree<T, Context>& parent1, const GPLinearTree<T, Context>& parent2, GPLinearTree<T, Context>& child1, GPLinearTree<T, Context>& child2) {
+            std::size_t index1 = parent1.getRandomIndex(this->rng);
+            std::size_t index2 = parent2.getRandomIndex(this->rng);
+
+            bool child1Valid = parent1.getSubtreeDepth() - parent1.getSubtreeDepth(index1) + parent2.getSubtreeDepth(index2) <= this->maxTreeDepth
+                            && parent1.getSubtreeSize() - parent1.getSubtreeSize(index1) + parent2.getSubtreeSize(index2) <= this->maxTreeNodes;
+
+            bool child2Valid = parent2.getSubtreeDepth() - parent2.getSubtreeDepth(index2) + parent1.getSubtreeDepth(index1) <= this->maxTreeDepth
+                            && parent2.getSubtreeSize() - parent2.getSubtreeSize(index2) + parent1.getSubtreeSize(index1) <= this->maxTreeNodes;
+
+            std::size_t count = 0;
+            if (child1Valid) {
+                child1.splice(parent1, index1, parent2.getSubtree(index2));
+                count++;
+            }
+
+            if (child2Valid) {
+                GPLinearTree<T, Context>& child = count == 0 ? child1 : child2;
+                child.splice(parent2, index2, parent1.getSubtree(index1));
+                count++;
+            }
+
+            return count;
+        }
+
+        std::pair<GPLinearTree<T, Context>*, GPLinearTree<T, Context>*> tournament() {
+            auto winners = gpTournament(this->populationSize, this->tournamentSize, this->competitors, this->rng);
+            return std::make_pair(&this->population[winners.first], &this->population[winners.second]);
+        }
+
+        // Same as GP::tuneConstants, an improved tree takes over the tuned genes
+        void tuneConstants() {
+            if (this->tunedIndividuals == 0 || ++this->generationsSinceTuning < this->tuningInterval) return;
+            this->generationsSinceTuning = 0;
+            const T* targets = this->penalty->getTargets(this->context);
+            if (targets == nullptr) return;
+
+            std::size_t count = std::min(this->tunedIndividuals, this->populationSize);
+            this->tuned.clear();
+            for (GPLinearTree<T, Context>& tree : this->population) this->tuned.push_back(&tree);
+            std::partial_sort(this->tuned.begin(), this->tuned.begin() + count, this->tuned.end(),
+                [](const auto& a, const auto& b) {
+                    return a->getPenalty() < b->getPenalty();
+                }
+            );
+            this->tuningEvaluations.assign(count, 0);
+            this->tuningImproved.assign(count, 0);
+
+            this->penalty->prepare();
+            this->pool.parallelFor(count, [this, targets](std::size_t index, std::size_t worker) {
+                GPLinearTree<T, Context>* tree = this->tuned[index];
+                std::vector<GPGene<T, Context>>& genes = this->tunedGenes[worker];
+                genes.assign(tree->getGenes().begin(), tree->getGenes().end());
+
+                bool improved;
+                this->tuningEvaluations[index] = this->tuners[worker].tune(genes, this->context, targets, this->tuningPasses, improved);
+                if (!improved) return;
+
+                GPProgram<T, Context>& program = this->programs[worker];
+                program.compile(std::span<const GPGene<T, Context>>(genes));
+                double penalty = this->penalty->calculate(this->context, program);
+                this->tuningEvaluations[index]++;
+                if (!(penalty < tree->getPenalty())) return;
+
+                tree->getGenes().swap(genes);
+                tree->recalculateHashes();
+                tree->setPenalty(penalty);
+                this->tuningImproved[index] = 1;
+            });
+
+            for (std::size_t i = 0 ; i < count ; i++) {
+                this->costEvaluations += this->tuningEvaluations[i];
+                this->improvedByTuning += this->tuningImproved[i];
+            }
+        }
+
+        void emitTelemetry(std::size_t evaluationsBefore) {
+            this->stats.generation = ++this->generation;
+            this->stats.costEvaluations = this->costEvaluations;
+            this->stats.generationEvaluations = this->costEvaluations - evaluationsBefore;
+            gpSummarize(this->population, this->penalties, this->stats, [](const GPLinearTree<T, Context>& tree) {
+                return std::make_tuple(tree.getPenalty(), tree.getSubtreeSize(), tree.getSubtreeDepth());
+            });
+            this->stats.selectionSeconds = this->timer.get(GPPhase::SELECTION);
+            this->stats.variationSeconds = this->timer.get(GPPhase::VARIATION);
+            this->stats.evaluationSeconds = this->timer.get(GPPhase::EVALUATION);
+            this->stats.arenaAllocations = 0;
+            std::size_t genes = this->spare.getGenes().capacity();
+            for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+                genes += this->population[i].getGenes().capacity() + this->nextPopulation[i].getGenes().capacity();
+            }
+            this->stats.reservedBytes = genes * sizeof(GPGene<T, Context>);
+            this->telemetry(this->stats);
+        }
+
+    public:
+        LinearGP(
+            std::vector<GPOperator<T, Context>> operators,
+            std::size_t populationSize,
+            std::size_t maxTreeDepth,
+            std::size_t maxTreeNodes,
+            std::size_t tournamentSize,
+            std::size_t elitism,
+            double pClone,
+            double pMutate,
+            double pCross,
+            T constantMin,
+            T constantMax,
+            IPenalty<T, Context>* penalty,
+            const Context& context,
+            std::size_t threads = 1,
+            std::mt19937::result_type seed = std::random_device{}()
+        ) :
+        populationSize(populationSize),
+        generator(operators, maxTreeDepth, maxTreeNodes, constantMin, constantMax),
+        costEvaluations(0),
+        maxTreeDepth(maxTreeDepth),
+        maxTreeNodes(maxTreeNodes),
+        tournamentSize(tournamentSize),
+        elitism(elitism),
+        pClone(pClone),
+        pMutate(pMutate),
+        pCross(pCross),
+        penalty(penalty),
+        pool(threads),
+        programs(pool.size()),
+        context(context),
+        rng(seed),
+        probDist(0.0, 1.0) {
+            this->population.resize(populationSize);
+            this->nextPopulation.resize(populationSize);
+        }
+
+        std::size_t getCostEvaluations() {
+            return this->costEvaluations;
+        }
+
+        // Same as GP::enableSubtreeCache
+        void enableSubtreeCache(std::size_t maxBytes) {
+            this->cache = std::make_unique<GPSubtreeCache<T>>(this->context.getRows(), maxBytes);
+        }
+
+        const GPSubtreeCache<T>* getSubtreeCache() const {
+            return this->cache.get();
+        }
+
+        void setRejectDuplicates(bool rejectDuplicates) {
+            this->rejectDuplicates = rejectDuplicates;
+        }
+
+        std::size_t getDuplicates() const {
+            return this->duplicates;
+        }
+
+        std::size_t getRejected() const {
+            return this->rejected;
+        }
+
+        void setEarlyAbort(std::size_t k) {
+            this->earlyAbort = std::min(k, this->populationSize);
+        }
+
+        std::size_t getAbortedEvaluations() const {
+            return this->abortedEvaluations;
+        }
+
+        void setSelection(GPSelection selection) {
+            this->selection = selection;
+        }
+
+        const std::vector<GPOperator<T, Context>>& getOperators() const {
+            return this->generator.getOperators();
+        }
+
+        // See GP::getCheckpoint
+        GPCheckpoint<T, Context> getCheckpoint() const {
+            GPCheckpoint<T, Context> checkpoint;
+            checkpoint.population.resize(this->populationSize);
+            for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+                const auto& genes = this->population[i].getGenes();
+                checkpoint.population[i].genes.assign(genes.begin(), genes.end());
+                checkpoint.population[i].penalty = this->population[i].getPenalty();
+                checkpoint.population[i].overThreshold = this->population[i].isOverThreshold();
+            }
+
+            checkpoint.costEvaluations = this->costEvaluations;
+            checkpoint.duplicates = this->duplicates;
+            checkpoint.rejected = this->rejected;
+            checkpoint.abortedEvaluations = this->abortedEvaluations;
+            checkpoint.improvedByTuning = this->improvedByTuning;
+            checkpoint.generationsSinceTuning = this->generationsSinceTuning;
+            std::ostringstream rng;
+            rng << this->rng;
+            checkpoint.rng = rng.str();
+            return checkpoint;
+        }
+
+        // See GP::restore
+        bool restore(const GPCheckpoint<T, Context>& checkpoint) {
+            if (checkpoint.population.size() != this->populationSize) return false;
+            std::istringstream rng(checkpoint.rng);
+            rng >> this->rng;
+            if (!rng) return false;
+
+            for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+                this->population[i].getGenes() = checkpoint.population[i].genes;
+                this->population[i].setPenalty(checkpoint.population[i].penalty, checkpoint.population[i].overThreshold);
+            }
+
+            this->costEvaluations = checkpoint.costEvaluations;
+            this->duplicates = checkpoint.duplicates;
+            this->rejected = checkpoint.rejected;
+            this->abortedEvaluations = checkpoint.abortedEvaluations;
+            this->improvedByTuning = checkpoint.improvedByTuning;
+            this->generationsSinceTuning = checkpoint.generationsSinceTuning;
+            return true;
+        }
+
+        // See GP::setConstantTuning
+        void setConstantTuning(std::size_t individuals, std::size_t interval = 1, std::size_t passes = 10) {
+            this->tunedIndividuals = individuals;
+            this->tuningInterval = std::max<std::size_t>(interval, 1);
+            this->tuningPasses = passes;
+            this->tuners.resize(this->pool.size());
+            this->tunedGenes.resize(this->pool.size());
+        }
+
+        std::size_t getImprovedByTuning() const {
+            return this->improvedByTuning;
+        }
+
+        // See GP::setTelemetry
+        void setTelemetry(std::function<void(const GPGenerationStats&)> callback) {
+            this->telemetry = std::move(callback);
+        }
+
+        GPLinearTree<T, Context>& getBestSolution() {
+            return *std::min_element(
+                this->population.begin(),
+                this->population.end(),
+                [](const GPLinearTree<T, Context>& a, const GPLinearTree<T, Context>& b) {
+                    return a.getPenalty() < b.getPenalty();
+                }
+            );
+        }
+
+        // Ramped half-and-half with an optional warm start, see GP::initializePopulation
+        void initializePopulation(const std::vector<GPMigrant<T, Context>>& seeds = {}) {
+            for (std::size_t i = this->populationSize / 2 ; i < this->populationSize ; i++) {
+                this->generator.grow(population[i].getGenes(), 2 + i % (this->maxTreeDepth - 1), this->maxTreeNodes, this->rng, true); // Depth is in [0, maxTreeDepth]
+            }
+
+            for (std::size_t i = 0; i < this->populationSize / 2 ; i++) {
+                this->generator.full(population[i].getGenes(), 2 + i % (this->generator.getMaxDepthFull() - 1), this->maxTreeNodes, this->rng); // Depth is in [0, maxDepthFull]
+            }
+
+            for (std::size_t i = 0 ; i < std::min(seeds.size(), this->populationSize) ; i++) {
+                population[i].getGenes() = seeds[i].genes;
+            }
+
+            for (auto& tree : population) {
+                this->schedule(&tree, false);
+            }
+            this->evaluateScheduled();
+        }
+
+        void newGeneration() {
+            std::size_t evaluationsBefore = this->costEvaluations;
+            this->timer.begin(static_cast<bool>(this->telemetry));
+
+            // Sort by fitness for elitism and tournaments
+            if (this->selection == GPSelection::PARETO) {
+                gpParetoSort(this->population, this->sortScratch, [](const GPLinearTree<T, Context>& tree) {
+                    return std::make_pair(tree.getPenalty(), tree.getSubtreeSize());
+                });
+            } else {
+                std::sort(this->population.begin(), this->population.end(),
+                    [](const auto& a, const auto& b) {
+                        return a.getPenalty() < b.getPenalty();
+                    }
+                );
+            }
+
+            this->parentPenalties.clear();
+            for (const auto& tree : this->population) {
+                this->parentPenalties.emplace(tree.getHash(), std::make_pair(tree.getPenalty(), tree.isOverThreshold()));
+            }
+            this->rejectedThisGeneration = 0;
+
+            if (this->earlyAbort != 0) {
+                this->penalties.clear();
+                for (const auto& tree : this->population) this->penalties.push_back(tree.getPenalty());
+                std::nth_element(this->penalties.begin(), this->penalties.end() - this->earlyAbort, this->penalties.end());
+                this->cutoff = this->penalties[this->populationSize - this->earlyAbort];
+            }
+            this->timer.charge(GPPhase::SELECTION);
+
+            std::size_t count = 0;
+            for ( ; count < this->elitism ; count++) {
+                this->nextPopulation[count] = this->population[count];
+            }
+            this->timer.charge(GPPhase::VARIATION);
+
+            while (count < this->populationSize) {
+                double roll = probDist(rng);
+                if (roll < this->pClone) {  // Clone
+                    const GPLinearTree<T, Context>* parent = this->tournament().first;
+                    this->timer.charge(GPPhase::SELECTION);
+                    this->nextPopulation[count++] = *parent;
+                } else if (roll < this->pClone + this->pMutate) {   // Mutate
+                    const GPLinearTree<T, Context>* parent = this->tournament().first;
+                    this->timer.charge(GPPhase::SELECTION);
+                    this->mutate(*parent, this->nextPopulation[count]);
+                    if (this->schedule(&this->nextPopulation[count], true)) count++;
+                } else {    // Cross
+                    auto parents = this->tournament();
+                    this->timer.charge(GPPhase::SELECTION);
+                    std::size_t first = count;
+                    GPLinearTree<T, Context>& second = first + 1 < this->populationSize ? this->nextPopulation[first + 1] : this->spare;
+                    std::size_t children = this->cross(*parents.first, *parents.second, this->nextPopulation[first], second);
+                    for (std::size_t i = 0 ; i < children && count < this->populationSize ; i++) {
+                        // If the first child was rejected the second one moves into it's slot
+                        GPLinearTree<T, Context>& child = i == 0 ? this->nextPopulation[first] : second;
+                        if (&child != &this->nextPopulation[count]) std::swap(child, this->nextPopulation[count]);
+                        if (this->schedule(&this->nextPopulation[count], true)) count++;
+                    }
+                }
+                this->timer.charge(GPPhase::VARIATION);
+            }
+
+            this->evaluateScheduled();
+
+            std::swap(this->population, this->nextPopulation);
+            this->tuneConstants();
+            this->timer.charge(GPPhase::EVALUATION);
+
+            if (this->telemetry) this->emitTelemetry(evaluationsBefore);
+        }
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include "GPTree.h"
+#include <concepts>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    Primitive sets fixed at compile time, an alternative to filling the operator table at runtime (as main does from parameters.txt):
+        auto operators = GPOpSet<GPAdd, GPSub, GPMul, GPSin, GPVar<0>, GPVar<1>, GPConst>::operators<double, Context>();
+    Built-in primitives become their opcodes, which the interpreter's switch runs with the GPKernels inlined.
+    Any other primitive is a struct with a symbol, an arity of 1 or 2 and a static kernel written like the GPKernels:
+        struct Square {
+            static constexpr const char* symbol = "sqr";
+            static constexpr std::size_t arity = 1;
+            template <typename T> static void kernel(std::span<T> a) { ... }     // Binary: kernel(std::span<T> a, std::span<const T> b)
+        };
+    It's instantiated for T and called once per block of samples, where a GPFunc is called through std::function for every sample
+*/
+
+template <GPOpcode Opcode, std::size_t Arity>
+struct GPPrimitive {
+    static constexpr GPOpcode opcode = Opcode;
+    static constexpr std::size_t arity = Arity;
+};
+
+struct GPAdd : GPPrimitive<GPOpcode::ADD, 2> { static constexpr const char* symbol = "+"; };
+struct GPSub : GPPrimitive<GPOpcode::SUB, 2> { static constexpr const char* symbol = "-"; };
+struct GPMul : GPPrimitive<GPOpcode::MUL, 2> { static constexpr const char* symbol = "*"; };
+struct GPDiv : GPPrimitive<GPOpcode::DIV, 2> { static constexpr const char* symbol = "/"; };
+struct GPSin : GPPrimitive<GPOpcode::SIN, 1> { static constexpr const char* symbol = "sin"; };
+struct GPCos : GPPrimitive<GPOpcode::COS, 1> { static constexpr const char* symbol = "cos"; };
+struct GPSqrt : GPPrimitive<GPOpcode::SQRT, 1> { static constexpr const char* symbol = "sqrt"; };
+struct GPLog : GPPrimitive<GPOpcode::LOG, 1> { static constexpr const char* symbol = "log"; };
+struct GPExp : GPPrimitive<GPOpcode::EXP, 1> { static constexpr const char* symbol = "exp"; };
+struct GPConst : GPPrimitive<GPOpcode::CONST, 0> { static constexpr const char* symbol = "C"; };
+
+// Input variable Index (column Index of the Context), printed as x1, x2, ... like in main
+template <std::size_t Index>
+struct GPVar : GPPrimitive<GPOpcode::VAR, 0> {
+    static constexpr std::size_t variable = Index;
+};
+
+template <typename Op>
+concept GPBuiltinPrimitive = requires {
+    { Op::opcode } -> std::convertible_to<GPOpcode>;
+};
+
+template <typename... Ops>
+class GPOpSet {
+    static_assert(sizeof...(Ops) > 0, "GPOpSet needs at least one primitive");
+    static_assert(((Ops::arity == 0) || ...), "GPOpSet needs at least one terminal");
+    static_assert(((GPBuiltinPrimitive<Ops> || Ops::arity == 1 || Ops::arity == 2) && ...), "Kernel primitives have to be unary or binary");
+
+    private:
+        template <typename Op, typename T>
+        static void kernel(T* a, const T* b, std::size_t count) {
+            if constexpr (Op::arity == 1) Op::kernel(std::span<T>(a, count));
+            else Op::kernel(std::span<T>(a, count), std::span<const T>(b, count));
+        }
+
+        template <typename Op, typename T, typename Context>
+        static GPOperator<T, Context> make() {
+            if constexpr (!GPBuiltinPrimitive<Op>) {
+                return {Op::symbol, nullptr, Op::arity, GPOpcode::KERNEL, 0, &GPOpSet::kernel<Op, T>};
+            } else if constexpr (Op::opcode == GPOpcode::VAR) {
+                return {"x" + std::to_string(Op::variable + 1), nullptr, 0, GPOpcode::VAR, Op::variable};
+            } else {
+                return {Op::symbol, nullptr, Op::arity, Op::opcode};
+            }
+        }
+
+    public:
+        static constexpr std::size_t size = sizeof...(Ops);
+
+        // In the order of Ops, for GP, LinearGP or GPGenerator
+        template <typename T, typename Context>
+        static std::vector<GPOperator<T, Context>> operators() {
+            return {make<Ops, T, Context>()...};
+        }
+};
\ No newline at end of file
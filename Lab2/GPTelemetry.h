@@ -0,0 +1,182 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// One record per generation, see GP::setTelemetry
+struct GPGenerationStats {
+    std::size_t generation = 0;             // Counted from 1 since the engine was created (or restored)
+    std::size_t costEvaluations = 0;        // Total so far
+    std::size_t generationEvaluations = 0;  // Spent by this generation, including constant tuning
+
+    double bestPenalty = 0;
+    double meanPenalty = 0;
+    double medianPenalty = 0;
+    double meanSize = 0;
+    std::size_t maxSize = 0;
+    double meanDepth = 0;
+    std::size_t maxDepth = 0;
+
+    // Wall time of the generation split by phase, the replacement step counts as selection
+    double selectionSeconds = 0;
+    double variationSeconds = 0;
+    double evaluationSeconds = 0;
+
+    std::size_t arenaAllocations = 0;   // Nodes and arrays created in the arenas (always 0 for the linear genome, which reuses it's buffers)
+    std::size_t reservedBytes = 0;      // Held by the arenas, or by the gene buffers of the linear genome
+};
+
+/*
+    Fills the population part of stats, describe(item) returns {penalty, size, depth}.
+    penalties is scratch space for the median
+*/
+template <typename Item, typename Describe>
+void gpSummarize(const std::vector<Item>& population, std::vector<double>& penalties, GPGenerationStats& stats, Describe describe) {
+    penalties.clear();
+    std::size_t sizes = 0;
+    std::size_t depths = 0;
+    stats.maxSize = 0;
+    stats.maxDepth = 0;
+    for (const Item& item : population) {
+        auto [penalty, size, depth] = describe(item);
+        penalties.push_back(penalty);
+        sizes += size;
+        depths += depth;
+        stats.maxSize = std::max(stats.maxSize, size);
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+    }
+    if (penalties.empty()) return;
+
+    double count = static_cast<double>(penalties.size());
+    stats.meanSize = sizes / count;
+    stats.meanDepth = depths / count;
+    stats.bestPenalty = *std::min_element(penalties.begin(), penalties.end());
+    double sum = 0;
+    for (double penalty : penalties) sum += penalty;
+    stats.meanPenalty = sum / count;
+    std::nth_element(penalties.begin(), penalties.begin() + penalties.size() / 2, penalties.end());
+    stats.medianPenalty = penalties[penalties.size() / 2];
+}
+
+enum class GPPhase {
+    SELECTION,
+    VARIATION,
+    EVALUATION
+};
+
+// Splits a generation's wall time into phases with one clock read per phase change, a disabled timer never reads the clock
+class GPPhaseTimer {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        bool enabled = false;
+        Clock::time_point last;
+        double seconds[3] = {};
+
+    public:
+        void begin(bool enabled) {
+            this->enabled = enabled;
+            std::fill(std::begin(this->seconds), std::end(this->seconds), 0.0);
+            if (enabled) this->last = Clock::now();
+        }
+
+        // The time since the previous call (or begin) was spent in phase
+        void charge(GPPhase phase) {
+            if (!this->enabled) return;
+            Clock::time_point now = Clock::now();
+            this->seconds[static_cast<std::size_t>(phase)] += std::chrono::duration<double>(now - this->last).count();
+            this->last = now;
+        }
+
+        bool isEnabled() const {
+            return this->enabled;
+        }
+
+        double get(GPPhase phase) const {
+            return this->seconds[static_cast<std::size_t>(phase)];
+        }
+};
+
+/*
+    Writes GPGenerationStats as CSV, or as JSON lines when the path ends with .jsonl
+    Records are formatted into a buffer that's written out in large blocks, so the file system isn't touched every generation
+*/
+class GPTelemetryWriter {
+    public:
+        static constexpr std::size_t bufferSize = 1 << 16;
+
+    private:
+        std::FILE* file = nullptr;
+        bool json = false;
+        std::string buffer;
+
+        void flush() {
+            if (this->file != nullptr && !this->buffer.empty()) std::fwrite(this->buffer.data(), 1, this->buffer.size(), this->file);
+            this->buffer.clear();
+        }
+
+        // JSON has no infinities or NaNs
+        void appendNumber(const char* format, double value) {
+            char text[32];
+            if (this->json && !std::isfinite(value)) {
+                this->buffer += "null";
+                return;
+            }
+            std::snprintf(text, sizeof(text), format, value);
+            this->buffer += text;
+        }
+
+    public:
+        GPTelemetryWriter(const std::string& path) : json(path.size() >= 6 && path.compare(path.size() - 6, 6, ".jsonl") == 0) {
+            this->file = std::fopen(path.c_str(), "w");
+            this->buffer.reserve(bufferSize);
+            if (this->file != nullptr && !this->json) {
+                this->buffer += "generation,costEvaluations,generationEvaluations,bestPenalty,meanPenalty,medianPenalty,meanSize,maxSize,meanDepth,maxDepth,"
+                                "selectionSeconds,variationSeconds,evaluationSeconds,arenaAllocations,reservedBytes\n";
+            }
+        }
+
+        GPTelemetryWriter(const GPTelemetryWriter&) = delete;
+        GPTelemetryWriter& operator=(const GPTelemetryWriter&) = delete;
+
+        ~GPTelemetryWriter() {
+            this->flush();
+            if (this->file != nullptr) std::fclose(this->file);
+        }
+
+        bool isOpen() const {
+            return this->file != nullptr;
+        }
+
+        void write(const GPGenerationStats& stats) {
+            const char* names[] = {
+                "generation", "costEvaluations", "generationEvaluations", "bestPenalty", "meanPenalty", "medianPenalty", "meanSize", "maxSize",
+                "meanDepth", "maxDepth", "selectionSeconds", "variationSeconds", "evaluationSeconds", "arenaAllocations", "reservedBytes"
+            };
+            double values[] = {
+                static_cast<double>(stats.generation), static_cast<double>(stats.costEvaluations), static_cast<double>(stats.generationEvaluations),
+                stats.bestPenalty, stats.meanPenalty, stats.medianPenalty, stats.meanSize, static_cast<double>(stats.maxSize),
+                stats.meanDepth, static_cast<double>(stats.maxDepth), stats.selectionSeconds, stats.variationSeconds, stats.evaluationSeconds,
+                static_cast<double>(stats.arenaAllocations), static_cast<double>(stats.reservedBytes)
+            };
+
+            if (this->json) this->buffer += '{';
+            for (std::size_t i = 0 ; i < std::size(values) ; i++) {
+                if (i != 0) this->buffer += ',';
+                if (this->json) {
+                    this->buffer += '"';
+                    this->buffer += names[i];
+                    this->buffer += "\":";
+                }
+                this->appendNumber("%.10g", values[i]);  // Counters are exact below 10^10
+            }
+            this->buffer += this->json ? "}\n" : "\n";
+
+            if (this->buffer.size() >= bufferSize) this->flush();
+        }
+};
\ No newline at end of file
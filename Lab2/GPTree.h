@@ -1,83 +1,203 @@
+#pragma once
 #include <vector>
 #include <memory>
 #include <string>
 #include <functional>
 #include <random>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include "GPArena.h"
+#include "../Common/ThreadPool.h"
+#include "GPKernels.h"
+#include "GPCache.h"
+#include "GPTelemetry.h"
 
 template <typename T, typename Context>
 class GPNode;
 
+template <typename T, typename Context>
+class GPProgram;
+
 template <typename T, typename Context>
 class GP;
 
+/*
+    Context describes the whole training set and is shared by all of it's samples, the engines copy it so it should be a light view
+    It has to provide getRows() and column(index), a contiguous array with the value of input variable index for every sample
+*/
+
+// User-defined operators receive the already evaluated values of their children (args[0..arity-1]) and the index of the sample
 template <typename T, typename Context>
-using GPFunc = std::function<T(std::string* symbol, const std::vector<std::unique_ptr<GPNode<T, Context>>>&, const Context&)>;
+using GPFunc = std::function<T(const T* args, const Context&, std::size_t sample)>;
+
+/*
+    User-defined operators can also be block kernels working like the GPKernels, the result is written into a (b is nullptr for unary operators).
+    Kernels must be pure, compiled programs may fold them over constants
+*/
+template <typename T>
+using GPBlockKernel = void (*)(T* a, const T* b, std::size_t count);
+
+// Built-in operators are executed directly by the interpreter, CUSTOM ones go through GPOperator::func and KERNEL ones through GPOperator::kernel
+enum class GPOpcode : std::uint8_t {
+    CUSTOM,
+    KERNEL, // Unary or binary, see GPOpSet
+    ADD,
+    SUB,
+    MUL,
+    DIV,    // Protected: x / 0 = 1
+    SIN,
+    COS,
+    SQRT,   // Protected: sqrt(x < 0) = 1
+    LOG,    // Protected: log10(x <= 0) = 1
+    EXP,
+    CONST,  // Ephemeral random constant, the value is drawn once when the node is created
+    VAR,    // Input variable, reads column GPOperator::variable of the Context
+    LOAD    // Outputs of a cached subtree, only emitted by GPProgram
+};
 
 template <typename T, typename Context>
 struct GPOperator {
     std::string symbol;
     GPFunc<T, Context> func;
     std::size_t arity;
+    GPOpcode opcode = GPOpcode::CUSTOM;
+    std::size_t variable = 0;   // Only used by VAR operators
+    GPBlockKernel<T> kernel = nullptr;  // Only used by KERNEL operators
+};
+
+/*
+    Canonical structural hash of a subtree, built from the root's operator and constant and then the children's hashes
+    Children of commutative operators (ADD, MUL) are combined independently of their order, so (a+b) and (b+a) hash equally
+    and, since both are exactly commutative in floating point, also evaluate equally.
+    Operators are identified by their address, so hashes are only comparable within one operator table
+*/
+class GPHash {
+    private:
+        std::uint64_t hash;
+        bool commutative;
+
+    public:
+        static std::uint64_t mix(std::uint64_t x) {    // splitmix64 finaliser
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+
+        template <typename T, typename Context>
+        GPHash(const GPOperator<T, Context>* oper, T value) :
+        hash(mix(reinterpret_cast<std::uintptr_t>(oper))),
+        commutative(oper->opcode == GPOpcode::ADD || oper->opcode == GPOpcode::MUL) {
+            if (oper->opcode == GPOpcode::CONST) {
+                std::uint64_t bits = 0;
+                std::memcpy(&bits, &value, std::min(sizeof(T), sizeof(bits)));
+                this->hash = mix(this->hash ^ bits);
+            }
+        }
+
+        // Children have to be added in order
+        void add(std::uint64_t child) {
+            if (this->commutative) this->hash += mix(child);
+            else this->hash = mix(this->hash + 0x9e3779b97f4a7c15ULL + child);
+        }
+
+        std::uint64_t get() const {
+            return mix(this->hash);
+        }
+};
+
+// One node of a tree stored as a contiguous prefix-order array
+template <typename T, typename Context>
+struct GPGene {
+    const GPOperator<T, Context>* oper;
+    std::uint32_t subtreeSize;      // The subtree rooted here spans this gene and the next subtreeSize - 1
+    std::uint32_t subtreeDepth;
+    std::uint64_t hash;             // GPHash of the subtree
+    T value;                        // Only used by CONST genes
 };
 
 template <typename T, typename Context>
 class GPNode {
     friend class GP<T, Context>;
+    friend class GPProgram<T, Context>;
 
     private:
-        GPOperator<T, Context> oper;
+        const GPOperator<T, Context>* oper;     // Entry of the GP operator table
         GPNode<T, Context>* parent;
-        std::vector<std::unique_ptr<GPNode<T, Context>>> children;
-        std::size_t subtreeSize;
-        std::size_t subtreeDepth;
+        GPNode<T, Context>** children;          // oper->arity entries, allocated in the same arena as the node
+        std::uint32_t subtreeSize;
+        std::uint32_t subtreeDepth;
+        std::uint64_t hash;     // GPHash of the subtree, maintained together with the sizes
+        T value = 0;    // Only used by CONST nodes
         double penalty = -1;    // Only necessary for root nodes
-
-        std::mt19937 rng;
+        bool overThreshold = false;     // The evaluation was aborted, penalty is only a lower bound
 
         std::size_t recalculateSubtreeSizesRecursive() {
             std::size_t sum = 1;
             std::size_t maxDepth = 0;
-            for (auto& child : this->children) {
+            GPHash hash(this->oper, this->value);
+            for (GPNode<T, Context>* child : this->getChildren()) {
                 sum += child->recalculateSubtreeSizesRecursive();
                 if (child->getSubtreeDepth() > maxDepth) maxDepth = child->getSubtreeDepth();
+                hash.add(child->hash);
             }
             this->subtreeSize = sum;
             this->subtreeDepth = maxDepth + 1;
+            this->hash = hash.get();
             return sum;
         }
         
     public:
-        GPNode(GPOperator<T, Context> oper, GPNode<T, Context>* parent = nullptr)
-        : oper(oper), parent(parent), rng(std::random_device{}()) {children.resize(oper.arity);}
+        GPNode(const GPOperator<T, Context>* oper, GPNode<T, Context>** children, GPNode<T, Context>* parent = nullptr)
+        : oper(oper), parent(parent), children(children) {}
 
         // Constructor for cloning
-        GPNode(const GPNode<T, Context>* node, GPNode<T, Context>* parent = nullptr) : 
+        GPNode(const GPNode<T, Context>* node, GPNode<T, Context>** children, GPNode<T, Context>* parent = nullptr) : 
             oper(node->oper),
             parent(parent),
+            children(children),
             subtreeSize(node->subtreeSize),
             subtreeDepth(node->subtreeDepth), 
-            penalty(node->penalty)
-            {children.resize(node->oper.arity);} 
+            hash(node->hash),
+            value(node->value),
+            penalty(node->penalty),
+            overThreshold(node->overThreshold)
+            {}
 
-        std::unique_ptr<GPNode<T, Context>> clone(GPNode<T, Context>* parent = nullptr) {
-            auto newNode = std::make_unique<GPNode<T, Context>>(this, parent);
+        GPNode<T, Context>* clone(GPArena& arena, GPNode<T, Context>* parent = nullptr) {
+            GPNode<T, Context>** children = arena.createArray<GPNode<T, Context>*>(this->oper->arity);
+            GPNode<T, Context>* newNode = arena.create<GPNode<T, Context>>(this, children, parent);
 
             std::size_t index = 0;
-            for (const auto& child : this->children) {
-                newNode->setChild(index, child->clone(newNode.get()));
+            for (GPNode<T, Context>* child : this->getChildren()) {
+                newNode->setChild(index, child->clone(arena, newNode));
                 index++;
             }
 
             return newNode;
         }
 
-        std::string& getSymbol() {
-            return oper.symbol;
+        const std::string& getSymbol() {
+            return oper->symbol;
         }
 
         std::size_t getArity() {
-            return oper.arity;
+            return oper->arity;
         }
 
         GPNode<T, Context>* getParent() {
@@ -89,15 +209,15 @@ class GPNode {
         } 
 
         GPNode<T, Context>* getChild(std::size_t index) {
-            return children[index].get();
+            return children[index];
         }
 
-        void setChild(std::size_t index, std::unique_ptr<GPNode<T, Context>> child) {
-            children[index] = std::move(child);
+        void setChild(std::size_t index, GPNode<T, Context>* child) {
+            children[index] = child;
         }
 
-        const std::vector<std::unique_ptr<GPNode<T, Context>>>& getChildren() {
-            return children;
+        std::span<GPNode<T, Context>*> getChildren() {
+            return std::span<GPNode<T, Context>*>(children, oper->arity);
         }
 
         std::size_t getSubtreeSize() {
@@ -108,15 +228,24 @@ class GPNode {
             return subtreeDepth;
         }
 
+        std::uint64_t getHash() {
+            return hash;
+        }
+
         double getPenalty() {
             return penalty;
         }
 
-        void setPenalty(double penalty) {
+        void setPenalty(double penalty, bool overThreshold = false) {
             this->penalty = penalty;
+            this->overThreshold = overThreshold;
         }
 
-        // Recalculates subtree sizes for this node, all it's children and the parent path until root
+        bool isOverThreshold() {
+            return overThreshold;
+        }
+
+        // Recalculates subtree sizes (and hashes) for this node, all it's children and the parent path until root
         void recalculateSubtreeSizes() {
             // Down
             recalculateSubtreeSizesRecursive();
@@ -126,19 +255,22 @@ class GPNode {
             while (node != nullptr) {
                 std::size_t sum = 1;
                 std::size_t maxDepth = 0;
-                for (const auto& child : node->children) {
+                GPHash hash(node->oper, node->value);
+                for (GPNode<T, Context>* child : node->getChildren()) {
                     sum += child->getSubtreeSize();
                     if (child->getSubtreeDepth() > maxDepth) maxDepth = child->getSubtreeDepth();
+                    hash.add(child->hash);
                 }
                 node->subtreeSize = sum;
                 node->subtreeDepth = maxDepth + 1;
+                node->hash = hash.get();
 
                 node = node->getParent();
             }
         }
 
         // Returns the randomly chosen node and it's index in it's parent's children list
-        std::pair<GPNode<T, Context>*, std::size_t> getRandomNode() {
+        std::pair<GPNode<T, Context>*, std::size_t> getRandomNode(std::mt19937& rng) {
             std::uniform_int_distribution<std::size_t> dist(1, this->subtreeSize - 1); 
             std::size_t budget = dist(rng);
 
@@ -147,11 +279,11 @@ class GPNode {
 
             while (budget != 0) {
                 childIndex = 0;
-                for (const auto& child : node->getChildren()) {
+                for (GPNode<T, Context>* child : node->getChildren()) {
                     if (budget > child->getSubtreeSize()) budget -= child->getSubtreeSize();
                     else {
                         budget--;
-                        node = child.get();
+                        node = child;
                         break;
                     }
                     childIndex++;
@@ -160,38 +292,595 @@ class GPNode {
 
             return std::make_pair(node, childIndex);
         }
-        
-        T evaluate(const Context& context) {
-            return oper.func(&oper.symbol, children, context);
+
+        // Appends the subtree to genes in prefix order
+        void toGenes(std::vector<GPGene<T, Context>>& genes) {
+            genes.push_back({this->oper, this->subtreeSize, this->subtreeDepth, this->hash, this->value});
+            for (GPNode<T, Context>* child : this->getChildren()) {
+                child->toGenes(genes);
+            }
         }
 
         std::string toString() {
-            switch (this->oper.arity) {
+            switch (this->oper->arity) {
                 case 0:
-                    if (this->oper.symbol == "") return "C";
-                    else return this->oper.symbol;
+                    if (this->oper->opcode == GPOpcode::CONST) return std::to_string(this->value);
+                    else return this->oper->symbol;
                 case 1:
-                    return this->oper.symbol + "(" + this->children[0]->toString() + ")";
+                    return this->oper->symbol + "(" + this->children[0]->toString() + ")";
                 case 2:
-                    return "(" + this->children[0]->toString() + this->oper.symbol + this->children[1]->toString() + ")"; 
+                    return "(" + this->children[0]->toString() + this->oper->symbol + this->children[1]->toString() + ")"; 
             }
 
             return "";
         }
 };
 
+template <typename T, typename Context>
+struct GPInstruction {
+    GPOpcode opcode;
+    std::size_t arity;
+    T value;                                // Only used by CONST instructions
+    const GPOperator<T, Context>* oper;     // Only used by CUSTOM, KERNEL and VAR instructions
+    const T* cached = nullptr;              // Only used by LOAD instructions, outputs of the subtree for every sample
+    T* record = nullptr;                    // If set, the result for every sample is also stored here
+};
+
+// A tree flattened into postfix order and executed by a stack interpreter
+template <typename T, typename Context>
+class GPProgram {
+    public:
+        static constexpr std::size_t batchSize = 256;   // Samples per block in evaluateBatch
+
+    private:
+        std::vector<GPInstruction<T, Context>> code;
+        std::size_t stackSize = 0;  // Values on the stack at it's deepest
+        std::vector<T> blockStack;  // stackSize blocks of batchSize values
+        std::vector<T> args;        // Arguments of a CUSTOM operator for a single sample
+
+        const GPSubtreeCache<T>* cache = nullptr;   // Only set while compiling
+        const void* owner = nullptr;                // The tree being compiled, as known to the cache
+        std::vector<std::size_t> fragments;         // Used by simplify, start of the code computing each stack value
+
+        // Returns true if a LOAD was emitted instead of the subtree, otherwise sets record to the cache entry this tree has to fill (if any)
+        bool emitCached(std::uint64_t hash, std::size_t subtreeSize, T*& record) {
+            record = nullptr;
+            if (this->cache == nullptr) return false;
+
+            const typename GPSubtreeCache<T>::Entry* entry = this->cache->find(hash, subtreeSize);
+            if (entry == nullptr) return false;
+            if (entry->ready) {
+                this->code.push_back({GPOpcode::LOAD, 0, T(0), nullptr, entry->outputs.data(), nullptr});
+                return true;
+            }
+            if (entry->owner == this->owner) record = const_cast<T*>(entry->outputs.data());
+            return false;
+        }
+
+        // Returns the stack size needed to evaluate the subtree
+        std::size_t emit(GPNode<T, Context>* node) {
+            T* record;
+            if (this->emitCached(node->hash, node->subtreeSize, record)) return 1;
+
+            std::size_t maxStack = 0;
+            std::size_t index = 0;
+            for (GPNode<T, Context>* child : node->getChildren()) {
+                maxStack = std::max(maxStack, index + this->emit(child));
+                index++;
+            }
+            this->code.push_back({node->oper->opcode, node->oper->arity, node->value, node->oper, nullptr, record});
+            return std::max<std::size_t>(maxStack, 1);
+        }
+
+        std::size_t emit(const GPGene<T, Context>* genes, std::size_t index) {
+            T* record;
+            if (this->emitCached(genes[index].hash, genes[index].subtreeSize, record)) return 1;
+
+            std::size_t maxStack = 0;
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                maxStack = std::max(maxStack, i + this->emit(genes, child));
+                child += genes[child].subtreeSize;
+            }
+            const GPOperator<T, Context>* oper = genes[index].oper;
+            this->code.push_back({oper->opcode, oper->arity, genes[index].value, oper, nullptr, record});
+            return std::max<std::size_t>(maxStack, 1);
+        }
+
+        // Computes a constant instruction with the same kernels evaluateBatch uses, so folding doesn't change the result
+        static T fold(const GPInstruction<T, Context>& instruction, T a, T b = T(0)) {
+            std::span<T> result(&a, 1);
+            std::span<const T> operand(&b, 1);
+            switch (instruction.opcode) {
+                case GPOpcode::KERNEL: instruction.oper->kernel(&a, instruction.arity == 2 ? &b : nullptr, 1); break;
+                case GPOpcode::ADD: GPKernels::add(result, operand); break;
+                case GPOpcode::SUB: GPKernels::sub(result, operand); break;
+                case GPOpcode::MUL: GPKernels::mul(result, operand); break;
+                case GPOpcode::DIV: GPKernels::div(result, operand); break;
+                case GPOpcode::SIN: GPKernels::sin(result); break;
+                case GPOpcode::COS: GPKernels::cos(result); break;
+                case GPOpcode::SQRT: GPKernels::sqrt(result); break;
+                case GPOpcode::LOG: GPKernels::log(result); break;
+                case GPOpcode::EXP: GPKernels::exp(result); break;
+                default: break;
+            }
+            return a;
+        }
+
+        /*
+            Peephole pass over the postfix code, the tree itself is left as it is
+            Folds constant subexpressions and removes identities: x+0, 0+x, x-0, x*1, 1*x, x/1, and for an input variable x also x-x, x/x and x*0.
+            Each rewrite computes exactly what the original code did (input variables are assumed finite), at most the sign of a zero can differ.
+            Instructions recording their outputs for the cache are only folded, never removed
+        */
+        void simplify() {
+            std::size_t out = 0;    // The code is compacted in place
+            this->fragments.clear();
+
+            auto constant = [&](std::size_t start, std::size_t end, T& value) {
+                if (end - start != 1 || this->code[start].opcode != GPOpcode::CONST || this->code[start].record != nullptr) return false;
+                value = this->code[start].value;
+                return true;
+            };
+            auto variable = [&](std::size_t start, std::size_t end) {
+                return end - start == 1 && this->code[start].opcode == GPOpcode::VAR;
+            };
+            auto emitConstant = [&](std::size_t start, T value, T* record) {
+                this->code[start] = {GPOpcode::CONST, 0, value, nullptr, nullptr, record};
+                out = start + 1;
+            };
+
+            for (std::size_t i = 0 ; i < this->code.size() ; i++) {
+                GPInstruction<T, Context> instruction = this->code[i];
+                GPOpcode opcode = instruction.opcode;
+                bool removable = instruction.record == nullptr;
+
+                if (opcode == GPOpcode::CONST || opcode == GPOpcode::VAR || opcode == GPOpcode::LOAD || opcode == GPOpcode::CUSTOM) {
+                    std::size_t arity = opcode == GPOpcode::CUSTOM ? instruction.arity : 0;
+                    std::size_t start = out;
+                    if (arity > 0) {
+                        start = this->fragments[this->fragments.size() - arity];
+                        this->fragments.resize(this->fragments.size() - arity);
+                    }
+                    this->code[out++] = instruction;
+                    this->fragments.push_back(start);
+                } else if (instruction.arity == 1) {
+                    std::size_t a = this->fragments.back();
+                    T x = T(0);
+                    if (constant(a, out, x)) emitConstant(a, fold(instruction, x), instruction.record);
+                    else this->code[out++] = instruction;
+                } else {
+                    std::size_t b = this->fragments.back();
+                    this->fragments.pop_back();
+                    std::size_t a = this->fragments.back();
+                    T x = T(0), y = T(0);
+                    bool constantA = constant(a, b, x);
+                    bool constantB = constant(b, out, y);
+
+                    if (constantA && constantB) {
+                        emitConstant(a, fold(instruction, x, y), instruction.record);
+                    } else if (removable && constantB && (((opcode == GPOpcode::ADD || opcode == GPOpcode::SUB) && y == 0) ||
+                                                          ((opcode == GPOpcode::MUL || opcode == GPOpcode::DIV) && y == 1))) {
+                        out = b;
+                    } else if (removable && constantA && ((opcode == GPOpcode::ADD && x == 0) || (opcode == GPOpcode::MUL && x == 1))) {
+                        std::copy(this->code.begin() + b, this->code.begin() + out, this->code.begin() + a);
+                        out -= b - a;
+                    } else if (removable && variable(a, b) && variable(b, out) && this->code[a].oper == this->code[b].oper && opcode == GPOpcode::SUB) {
+                        emitConstant(a, T(0), nullptr);
+                    } else if (removable && variable(a, b) && variable(b, out) && this->code[a].oper == this->code[b].oper && opcode == GPOpcode::DIV) {
+                        emitConstant(a, T(1), nullptr);
+                    } else if (removable && opcode == GPOpcode::MUL && ((constantA && x == 0 && variable(b, out)) || (constantB && y == 0 && variable(a, b)))) {
+                        emitConstant(a, T(0), nullptr);
+                    } else {
+                        this->code[out++] = instruction;
+                    }
+                }
+            }
+
+            this->code.resize(out);
+        }
+
+        void allocateScratch() {
+            this->blockStack.resize(this->stackSize * batchSize);
+
+            std::size_t maxArity = 0;
+            for (const auto& instruction : this->code) maxArity = std::max(maxArity, instruction.arity);
+            this->args.resize(maxArity);
+        }
+
+    public:
+        /*
+            With a cache, subtrees whose outputs are ready are replaced by LOAD instructions and the entries reserved for this tree get filled;
+            such a program has to be run with evaluateBatch over the whole training set.
+            The code is then simplified, which doesn't change what it computes
+        */
+        void compile(GPNode<T, Context>& tree, const GPSubtreeCache<T>* cache = nullptr) {
+            this->cache = cache;
+            this->owner = &tree;
+            this->code.clear();
+            this->code.reserve(tree.getSubtreeSize());
+            this->stackSize = this->emit(&tree);
+            this->simplify();
+            this->allocateScratch();
+            this->cache = nullptr;
+        }
+
+        void compile(std::span<const GPGene<T, Context>> genes, const GPSubtreeCache<T>* cache = nullptr) {
+            this->cache = cache;
+            this->owner = genes.data();
+            this->code.clear();
+            this->code.reserve(genes.size());
+            this->stackSize = this->emit(genes.data(), 0);
+            this->simplify();
+            this->allocateScratch();
+            this->cache = nullptr;
+        }
+
+        std::size_t size() const {
+            return code.size();
+        }
+
+        /*
+            Evaluates samples [first, first + count) at once, count can be at most batchSize
+            Every instruction processes the whole block before the next one runs
+        */
+        void evaluateBatch(const Context& context, std::size_t first, std::size_t count, T* out) {
+            T* base = blockStack.data();
+            std::size_t top = 0;    // Number of blocks on the stack
+
+            auto block = [&](std::size_t index) {
+                return std::span<T>(base + index * batchSize, count);
+            };
+
+            for (const auto& instruction : code) {
+                switch (instruction.opcode) {
+                    case GPOpcode::ADD:
+                        top--;
+                        GPKernels::add(block(top - 1), std::span<const T>(block(top)));
+                        break;
+
+                    case GPOpcode::SUB:
+                        top--;
+                        GPKernels::sub(block(top - 1), std::span<const T>(block(top)));
+                        break;
+
+                    case GPOpcode::MUL:
+                        top--;
+                        GPKernels::mul(block(top - 1), std::span<const T>(block(top)));
+                        break;
+
+                    case GPOpcode::DIV:
+                        top--;
+                        GPKernels::div(block(top - 1), std::span<const T>(block(top)));
+                        break;
+
+                    case GPOpcode::SIN:
+                        GPKernels::sin(block(top - 1));
+                        break;
+
+                    case GPOpcode::COS:
+                        GPKernels::cos(block(top - 1));
+                        break;
+
+                    case GPOpcode::SQRT:
+                        GPKernels::sqrt(block(top - 1));
+                        break;
+
+                    case GPOpcode::LOG:
+                        GPKernels::log(block(top - 1));
+                        break;
+
+                    case GPOpcode::EXP:
+                        GPKernels::exp(block(top - 1));
+                        break;
+
+                    case GPOpcode::CONST: {
+                        std::span<T> result = block(top);
+                        std::fill(result.begin(), result.end(), instruction.value);
+                        top++;
+                        break;
+                    }
+
+                    case GPOpcode::VAR: {
+                        const T* column = context.column(instruction.oper->variable);
+                        std::copy(column + first, column + first + count, block(top).begin());
+                        top++;
+                        break;
+                    }
+
+                    case GPOpcode::LOAD:
+                        std::copy(instruction.cached + first, instruction.cached + first + count, block(top).begin());
+                        top++;
+                        break;
+
+                    case GPOpcode::CUSTOM: {
+                        std::size_t firstArg = top - instruction.arity;
+                        const GPFunc<T, Context>& func = instruction.oper->func;
+                        T* result = base + firstArg * batchSize;
+                        for (std::size_t i = 0 ; i < count ; i++) {
+                            for (std::size_t j = 0 ; j < instruction.arity ; j++) {
+                                args[j] = base[(firstArg + j) * batchSize + i];
+                            }
+                            result[i] = func(args.data(), context, first + i);
+                        }
+                        top = firstArg + 1;
+                        break;
+                    }
+
+                    case GPOpcode::KERNEL:
+                        if (instruction.arity == 2) {
+                            top--;
+                            instruction.oper->kernel(block(top - 1).data(), block(top).data(), count);
+                        } else {
+                            instruction.oper->kernel(block(top - 1).data(), nullptr, count);
+                        }
+                        break;
+                }
+
+                if (instruction.record != nullptr) {
+                    std::span<T> result = block(top - 1);
+                    std::copy(result.begin(), result.end(), instruction.record + first);
+                }
+            }
+
+            std::copy(base, base + count, out);
+        }
+};
+
 template <typename T, typename Context>
 class IPenalty {
     public:
-        virtual double calculate(std::vector<Context>& contexts, GPNode<T, Context>& tree) = 0; 
+        // GP evaluates offspring in parallel, so this may run on several threads at once, each with it's own program
+        virtual double calculate(const Context& context, GPProgram<T, Context>& program) = 0; 
+
+        /*
+            May stop as soon as the penalty is known to exceed cutoff and return a lower bound above it instead, aborted tells if it did
+            (a penalty above the cutoff can also be exact). By default the cutoff is ignored
+        */
+        virtual double calculate(const Context& context, GPProgram<T, Context>& program, double, bool& aborted) {
+            aborted = false;
+            return this->calculate(context, program);
+        }
+
+        // Called before every parallel evaluation, while no calculate is running
+        virtual void prepare() {}
+
+        // Expected output for every sample if the penalty grows with the sum of squared errors, needed for constant tuning; nullptr disables it
+        virtual const T* getTargets(const Context&) {
+            return nullptr;
+        }
 };
 
+/*
+    Memetic step: tunes the CONST genes of a tree by Levenberg-Marquardt on the sum of squared errors against the targets,
+    the Jacobian comes from forward-mode differentiation through the genes (values and derivatives by every constant travel together).
+    Trees with CUSTOM or KERNEL operators can't be differentiated and are left as they are
+*/
 template <typename T, typename Context>
-class GP {
+class GPConstantTuner {
     private:
-        std::vector<std::unique_ptr<GPNode<T, Context>>> population;
-        std::size_t populationSize;
+        std::vector<std::size_t> code;          // Gene indices in postfix order
+        std::vector<std::size_t> parameter;     // For every CONST gene it's index among the tuned constants
+        std::vector<std::size_t> constants;     // Gene indices of the tuned constants
+        std::vector<double> stack;              // Every slot holds a value and it's derivatives by all constants
+
+        // Normal equations at the current constants and at the last trial
+        std::vector<double> hessian, gradient;
+        std::vector<double> trialHessian, trialGradient;
+        std::vector<double> factor, step, current;
+
+        void emit(std::span<const GPGene<T, Context>> genes, std::size_t index) {
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                this->emit(genes, child);
+                child += genes[child].subtreeSize;
+            }
+            this->code.push_back(index);
+        }
+
+        // One pass over the training set, returns the sum of squared errors and accumulates JᵀJ and Jᵀr into trialHessian and trialGradient
+        double pass(std::span<const GPGene<T, Context>> genes, const Context& context, const T* targets) {
+            std::size_t k = this->constants.size();
+            std::size_t stride = k + 1;
+            std::fill(this->trialHessian.begin(), this->trialHessian.end(), 0.0);
+            std::fill(this->trialGradient.begin(), this->trialGradient.end(), 0.0);
+            double sse = 0;
+
+            for (std::size_t sample = 0 ; sample < context.getRows() ; sample++) {
+                double* top = this->stack.data();   // One past the last slot
+
+                for (std::size_t index : this->code) {
+                    const GPGene<T, Context>& gene = genes[index];
+                    double* a = top - 2 * stride;   // Operands of binary operators
+                    double* b = top - stride;
+
+                    switch (gene.oper->opcode) {
+                        case GPOpcode::CONST:
+                            std::fill(top, top + stride, 0.0);
+                            top[0] = gene.value;
+                            top[1 + this->parameter[index]] = 1;
+                            top += stride;
+                            break;
+
+                        case GPOpcode::VAR:
+                            std::fill(top, top + stride, 0.0);
+                            top[0] = context.column(gene.oper->variable)[sample];
+                            top += stride;
+                            break;
+
+                        case GPOpcode::ADD:
+                            for (std::size_t j = 0 ; j < stride ; j++) a[j] += b[j];
+                            top = b;
+                            break;
+
+                        case GPOpcode::SUB:
+                            for (std::size_t j = 0 ; j < stride ; j++) a[j] -= b[j];
+                            top = b;
+                            break;
+
+                        case GPOpcode::MUL:
+                            for (std::size_t j = 1 ; j < stride ; j++) a[j] = a[j] * b[0] + a[0] * b[j];
+                            a[0] *= b[0];
+                            top = b;
+                            break;
+
+                        case GPOpcode::DIV:
+                            if (b[0] == 0) {
+                                std::fill(a, a + stride, 0.0);
+                                a[0] = 1;
+                            } else {
+                                double quotient = a[0] / b[0];
+                                for (std::size_t j = 1 ; j < stride ; j++) a[j] = (a[j] - quotient * b[j]) / b[0];
+                                a[0] = quotient;
+                            }
+                            top = b;
+                            break;
+
+                        default: {  // Unary operators, derivative is the local slope times the argument's derivatives
+                            double* x = b;
+                            double value, slope;
+                            switch (gene.oper->opcode) {
+                                case GPOpcode::SIN:
+                                    value = std::sin(x[0]);
+                                    slope = std::cos(x[0]);
+                                    break;
+                                case GPOpcode::COS:
+                                    value = std::cos(x[0]);
+                                    slope = -std::sin(x[0]);
+                                    break;
+                                case GPOpcode::SQRT:
+                                    value = x[0] < 0 ? 1 : std::sqrt(x[0]);
+                                    slope = x[0] > 0 ? 0.5 / value : 0;
+                                    break;
+                                case GPOpcode::LOG:
+                                    value = x[0] <= 0 ? 1 : std::log10(x[0]);
+                                    slope = x[0] > 0 ? 1 / (x[0] * std::log(10.0)) : 0;
+                                    break;
+                                default:    // EXP
+                                    value = std::exp(x[0]);
+                                    slope = value;
+                                    break;
+                            }
+                            for (std::size_t j = 1 ; j < stride ; j++) x[j] *= slope;
+                            x[0] = value;
+                            break;
+                        }
+                    }
+                }
+
+                double residual = this->stack[0] - targets[sample];
+                sse += residual * residual;
+                const double* derivatives = this->stack.data() + 1;
+                for (std::size_t j = 0 ; j < k ; j++) {
+                    this->trialGradient[j] += residual * derivatives[j];
+                    for (std::size_t l = 0 ; l <= j ; l++) this->trialHessian[j * k + l] += derivatives[j] * derivatives[l];
+                }
+            }
+
+            return sse;
+        }
+
+        // Solves (JᵀJ + lambda * diag(JᵀJ)) step = -Jᵀr by Cholesky decomposition, only the lower triangle of the hessian is used
+        bool solve(double lambda) {
+            std::size_t k = this->constants.size();
+            for (std::size_t j = 0 ; j < k ; j++) {
+                for (std::size_t l = 0 ; l <= j ; l++) {
+                    double sum = this->hessian[j * k + l];
+                    if (l == j) sum += lambda * sum + 1e-12;
+                    for (std::size_t m = 0 ; m < l ; m++) sum -= this->factor[j * k + m] * this->factor[l * k + m];
+
+                    if (l == j) {
+                        if (!(sum > 0)) return false;
+                        this->factor[j * k + j] = std::sqrt(sum);
+                    } else {
+                        this->factor[j * k + l] = sum / this->factor[l * k + l];
+                    }
+                }
+            }
+
+            for (std::size_t j = 0 ; j < k ; j++) {
+                double sum = -this->gradient[j];
+                for (std::size_t m = 0 ; m < j ; m++) sum -= this->factor[j * k + m] * this->step[m];
+                this->step[j] = sum / this->factor[j * k + j];
+            }
+            for (std::size_t j = k ; j-- > 0 ; ) {
+                double sum = this->step[j];
+                for (std::size_t m = j + 1 ; m < k ; m++) sum -= this->factor[m * k + j] * this->step[m];
+                this->step[j] = sum / this->factor[j * k + j];
+            }
+            return std::all_of(this->step.begin(), this->step.end(), [](double x) {return std::isfinite(x);});
+        }
+
+    public:
+        /*
+            Runs at most passes passes over the training set and leaves the best constants found in genes (only their values change, hashes are stale).
+            Returns the number of passes actually made, improved tells whether the constants changed
+        */
+        std::size_t tune(std::span<GPGene<T, Context>> genes, const Context& context, const T* targets, std::size_t passes, bool& improved) {
+            improved = false;
+            this->code.clear();
+            this->constants.clear();
+            this->parameter.assign(genes.size(), 0);
+            for (std::size_t i = 0 ; i < genes.size() ; i++) {
+                if (genes[i].oper->opcode == GPOpcode::CUSTOM || genes[i].oper->opcode == GPOpcode::KERNEL) return 0;
+                if (genes[i].oper->opcode == GPOpcode::CONST) {
+                    this->parameter[i] = this->constants.size();
+                    this->constants.push_back(i);
+                }
+            }
+            std::size_t k = this->constants.size();
+            if (k == 0 || passes == 0) return 0;
+
+            this->emit(genes, 0);
+            this->stack.resize(genes[0].subtreeDepth * (k + 1));
+            this->hessian.resize(k * k);
+            this->trialHessian.resize(k * k);
+            this->factor.resize(k * k);
+            this->gradient.resize(k);
+            this->trialGradient.resize(k);
+            this->step.resize(k);
+            this->current.resize(k);
+
+            double sse = this->pass(genes, context, targets);
+            std::size_t done = 1;
+            if (!std::isfinite(sse)) return done;
+            std::swap(this->hessian, this->trialHessian);
+            std::swap(this->gradient, this->trialGradient);
+
+            double lambda = 1e-3;
+            while (done < passes && lambda < 1e10) {
+                if (!this->solve(lambda)) {
+                    lambda *= 10;
+                    continue;
+                }
+
+                for (std::size_t j = 0 ; j < k ; j++) {
+                    this->current[j] = genes[this->constants[j]].value;
+                    genes[this->constants[j]].value = static_cast<T>(this->current[j] + this->step[j]);
+                }
+                double trial = this->pass(genes, context, targets);
+                done++;
+
+                if (trial < sse) {
+                    sse = trial;
+                    improved = true;
+                    std::swap(this->hessian, this->trialHessian);
+                    std::swap(this->gradient, this->trialGradient);
+                    lambda = std::max(lambda / 10, 1e-12);
+                } else {
+                    for (std::size_t j = 0 ; j < k ; j++) genes[this->constants[j]].value = static_cast<T>(this->current[j]);
+                    lambda *= 10;
+                }
+            }
+
+            return done;
+        }
+};
 
+// Operator table and the random initialisation methods, trees are generated as prefix-order genes
+template <typename T, typename Context>
+class GPGenerator {
+    private:
         std::vector<GPOperator<T, Context>> operators;  // Sorted by arity; Terminals are also operators, but with arity 0
         std::vector<std::size_t> operCountUpToArity;    // Number of operators of arity that's less or equal than index...
         std::size_t minNonZeroArity = -1;
@@ -203,23 +892,84 @@ class GP {
         std::vector<std::size_t> minArityGeometricSeries;
         std::size_t maxDepthFull;
 
-        std::size_t costEvaluations;
-        std::size_t maxTreeDepth;
-        std::size_t maxTreeNodes;
-        std::size_t tournamentSize;
-        std::size_t elitism;
-        double pClone;
-        double pMutate;
-        double pCross;
+        std::uniform_real_distribution<T> constantDist;
 
-        IPenalty<T, Context>* penalty;
+        // Appends the gene of a new node and returns it's index, the extent is filled in by finish() once the children are appended
+        std::size_t append(std::vector<GPGene<T, Context>>& genes, const GPOperator<T, Context>& oper, std::mt19937& rng) {
+            T value = 0;
+            if (oper.opcode == GPOpcode::CONST) value = this->constantDist(rng);
+            genes.push_back({&oper, 1, 1, GPHash(&oper, value).get(), value});  // Terminals are never finished, so this is their final hash
+            return genes.size() - 1;
+        }
 
-        std::vector<Context> contexts;
+        void finish(std::vector<GPGene<T, Context>>& genes, std::size_t index) {
+            std::uint32_t maxDepth = 0;
+            GPHash hash(genes[index].oper, genes[index].value);
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                maxDepth = std::max(maxDepth, genes[child].subtreeDepth);
+                hash.add(genes[child].hash);
+                child += genes[child].subtreeSize;
+            }
+            genes[index].subtreeSize = genes.size() - index;
+            genes[index].subtreeDepth = maxDepth + 1;
+            genes[index].hash = hash.get();
+        }
 
-        std::mt19937 rng;
-        std::uniform_real_distribution<double> probDist;
+    public:
+        GPGenerator(std::vector<GPOperator<T, Context>> operators, std::size_t maxTreeDepth, std::size_t maxTreeNodes, T constantMin, T constantMax) :
+        operators(operators),
+        constantDist(constantMin, constantMax) {
+            std::sort(this->operators.begin(), this->operators.end(),
+                [](auto const& a, auto const& b) {
+                    return a.arity < b.arity;
+                }
+            );
+            
+            this->maxArity = this->operators.back().arity;
+
+            this->operCountUpToArity.resize(this->maxArity + 1);
+            for (const auto& oper : this->operators) {
+                this->operCountUpToArity[oper.arity]++;
+                if (this->minNonZeroArity == -1 && oper.arity != 0) this->minNonZeroArity = oper.arity;
+            }
 
-        std::unique_ptr<GPNode<T, Context>> full(std::size_t maxDepth, std::size_t maxNodes, GPNode<T, Context>* parent = nullptr) {
+            std::size_t count = 0;
+            for (std::size_t i = 0 ; i <= this->maxArity ; i++) {
+                this->operCountUpToArity[i] += count;
+                count = this->operCountUpToArity[i];
+            }
+
+            std::size_t geoSum = 1;
+            minArityGeometricSeries.push_back(geoSum);
+            for (std::size_t N = 1; N < 20 ; N++) {
+                geoSum *= this->minNonZeroArity;
+                this->minArityGeometricSeries.push_back(this->minArityGeometricSeries[N-1] + geoSum);
+            }
+
+            // Find the highest depth for full init (using only minimal non-zero arity operators)
+            for (std::size_t d = maxTreeDepth ; d > 1 ; d--) {
+                if (maxTreeNodes >= this->minArityGeometricSeries[d-1]) {
+                    this->maxDepthFull = d;
+                    break;
+                }
+            }
+        }
+
+        // The table must not move while trees point into it
+        GPGenerator(const GPGenerator&) = delete;
+        GPGenerator& operator=(const GPGenerator&) = delete;
+
+        const std::vector<GPOperator<T, Context>>& getOperators() const {
+            return operators;
+        }
+
+        std::size_t getMaxDepthFull() const {
+            return maxDepthFull;
+        }
+
+        // Appends a full tree to genes
+        void full(std::vector<GPGene<T, Context>>& genes, std::size_t maxDepth, std::size_t maxNodes, std::mt19937& rng) {
             // Find the highest arity we can use for this node and still be able to generate a full tree if using the lowest non-zero arity
             std::size_t arity = -1;
             if (maxDepth == 1) arity = 0;
@@ -240,9 +990,9 @@ class GP {
             } else {
                 distArities = std::uniform_int_distribution<std::size_t>(this->operCountUpToArity[0], this->operCountUpToArity[arity] - 1);
             }
-            GPOperator<T, Context>& oper = this->operators[distArities(rng)];
-            std::unique_ptr<GPNode<T, Context>> node = std::make_unique<GPNode<T, Context>>(oper, parent);
-            if (maxDepth == 1) return node;
+            const GPOperator<T, Context>& oper = this->operators[distArities(rng)];
+            std::size_t index = this->append(genes, oper, rng);
+            if (maxDepth == 1) return;
             /*  
                 Split the budget (maxNodes) between children nodes
                 Each child needs a budget of at least GeometricSeries[child's maxDepth - 1] so we reduce by that * oper.arity
@@ -257,12 +1007,13 @@ class GP {
             }
             std::sort(splitters.begin(), splitters.end());
             for (std::size_t i = 0 ; i < splitters.size() - 1 ; i++) {
-                node->setChild(i, this->full(maxDepth - 1, this->minArityGeometricSeries[maxDepth - 2] + splitters[i+1] - splitters[i], node.get()));
+                this->full(genes, maxDepth - 1, this->minArityGeometricSeries[maxDepth - 2] + splitters[i+1] - splitters[i], rng);
             }
-            return node;
+            this->finish(genes, index);
         }
         
-        std::unique_ptr<GPNode<T, Context>> grow(std::size_t maxDepth, std::size_t maxNodes, GPNode<T, Context>* parent = nullptr, bool banTerminals = false) {
+        // Appends a grown tree to genes
+        void grow(std::vector<GPGene<T, Context>>& genes, std::size_t maxDepth, std::size_t maxNodes, std::mt19937& rng, bool banTerminals = false) {
             std::size_t arity = this->maxArity;
             // Max arity this node's operator can be based on the leftover budget (maxNodes)
             if (maxNodes < this->maxArity + 1) arity = maxNodes - 1;
@@ -273,9 +1024,9 @@ class GP {
             } else {
                 distArities = std::uniform_int_distribution<std::size_t>(0, this->operCountUpToArity[arity] - 1);
             }
-            GPOperator<T, Context> oper = this->operators[distArities(rng)];
-            std::unique_ptr<GPNode<T, Context>> node = std::make_unique<GPNode<T, Context>>(oper, parent);
-            if (maxDepth == 1 || oper.arity == 0) return node;     // Not necessary, but helps
+            const GPOperator<T, Context>& oper = this->operators[distArities(rng)];
+            std::size_t index = this->append(genes, oper, rng);
+            if (maxDepth == 1 || oper.arity == 0) return;     // Not necessary, but helps
             /*  
                 Split the budget (maxNodes) between children nodes
                 Each child needs a budget of at least 1 so we reduce by oper.arity
@@ -292,39 +1043,465 @@ class GP {
             }
             std::sort(splitters.begin(), splitters.end());
             for (std::size_t i = 0 ; i < splitters.size() - 1 ; i++) {
-                node->setChild(i, this->grow(maxDepth - 1, 1 + splitters[i+1] - splitters[i], node.get()));
+                this->grow(genes, maxDepth - 1, 1 + splitters[i+1] - splitters[i], rng);
+            }
+            this->finish(genes, index);
+        }
+};
+
+/*
+    Tournament among tournamentSize distinct random individuals, without touching the population
+    The engines keep their population sorted by penalty while selecting, so an index is also the rank and the smallest sampled indices win.
+    Returns the two winners (the same one twice for a tournament of one); competitors is scratch space
+*/
+inline std::pair<std::size_t, std::size_t> gpTournament(std::size_t populationSize, std::size_t tournamentSize, std::vector<std::size_t>& competitors, std::mt19937& rng) {
+    std::uniform_int_distribution<std::size_t> dist(0, populationSize - 1);
+    std::size_t first = populationSize;
+    std::size_t second = populationSize;
+
+    competitors.clear();
+    while (competitors.size() < tournamentSize) {
+        std::size_t index = dist(rng);
+        if (std::find(competitors.begin(), competitors.end(), index) != competitors.end()) continue;   // Tournaments are small, a linear scan is enough
+        competitors.push_back(index);
+
+        if (index < first) {
+            second = first;
+            first = index;
+        } else if (index < second) {
+            second = index;
+        }
+    }
+
+    return std::make_pair(first, second == populationSize ? first : second);
+}
+
+enum class GPSelection {
+    PENALTY,    // The population is ordered by penalty
+    PARETO      // By non-dominated rank on (penalty, size) first, so small trees win against bigger ones that aren't better
+};
+
+/*
+    Orders items by non-dominated rank on (penalty, size), both minimised, and by penalty within a rank, so the best penalty stays first.
+    With two objectives the ranks come from one pass in penalty order: an item joins the first front whose smallest size is larger than it's own.
+    Items equal in both objectives land in successive fronts, so copies of one individual don't fill the first front.
+    key(item) returns (penalty, size), scratch is swapped with items
+*/
+template <typename Item, typename Key>
+void gpParetoSort(std::vector<Item>& items, std::vector<Item>& scratch, Key key) {
+    std::sort(items.begin(), items.end(), [&key](const Item& a, const Item& b) {return key(a) < key(b);});
+
+    std::vector<std::size_t> ranks(items.size());
+    std::vector<std::size_t> smallest;  // Smallest size in every front, never decreasing from one front to the next
+    std::vector<std::size_t> offsets;   // Items per front, then where the front starts
+    for (std::size_t i = 0 ; i < items.size() ; i++) {
+        std::size_t size = key(items[i]).second;
+        std::size_t front = std::upper_bound(smallest.begin(), smallest.end(), size) - smallest.begin();
+        if (front == smallest.size()) {
+            smallest.push_back(size);
+            offsets.push_back(0);
+        } else {
+            smallest[front] = size;
+        }
+        ranks[i] = front;
+        offsets[front]++;
+    }
+
+    std::size_t start = 0;
+    for (std::size_t& offset : offsets) {
+        std::size_t count = offset;
+        offset = start;
+        start += count;
+    }
+
+    scratch.resize(items.size());
+    for (std::size_t i = 0 ; i < items.size() ; i++) {
+        scratch[offsets[ranks[i]]++] = std::move(items[i]);
+    }
+    items.swap(scratch);
+}
+
+// An individual outside of it's population, see GP::getBest, GP::replaceWorst and GPCheckpoint
+template <typename T, typename Context>
+struct GPMigrant {
+    std::vector<GPGene<T, Context>> genes;
+    double penalty;
+    bool overThreshold;
+};
+
+/*
+    State of a GP run: the population, the counters and the random generator, see GP::getCheckpoint and GP::restore
+    Files are binary and native-endian. Genes are stored as operator indices, so a checkpoint can only be loaded with the same operator table
+    (checked by symbols); extents, depths and hashes are recalculated on load
+*/
+template <typename T, typename Context>
+struct GPCheckpoint {
+    static constexpr char magic[8] = {'G', 'P', 'C', 'K', 'P', 'T', '0', '1'};
+
+    std::vector<GPMigrant<T, Context>> population;
+    std::uint64_t costEvaluations = 0;
+    std::uint64_t duplicates = 0;
+    std::uint64_t rejected = 0;
+    std::uint64_t abortedEvaluations = 0;
+    std::uint64_t improvedByTuning = 0;
+    std::uint64_t generationsSinceTuning = 0;
+    std::string rng;    // std::mt19937 state as written by operator<<
+
+    // Writes to path.tmp first and renames it, so a run killed while saving leaves the previous checkpoint intact
+    bool save(const std::string& path, const std::vector<GPOperator<T, Context>>& operators) const {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            auto write = [&file](const auto& value) {
+                file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            };
+            auto writeString = [&](const std::string& value) {
+                write(static_cast<std::uint64_t>(value.size()));
+                file.write(value.data(), value.size());
+            };
+
+            file.write(magic, sizeof(magic));
+            write(static_cast<std::uint64_t>(sizeof(T)));
+            write(static_cast<std::uint64_t>(operators.size()));
+            for (const auto& oper : operators) writeString(oper.symbol);
+
+            write(this->costEvaluations);
+            write(this->duplicates);
+            write(this->rejected);
+            write(this->abortedEvaluations);
+            write(this->improvedByTuning);
+            write(this->generationsSinceTuning);
+            writeString(this->rng);
+
+            write(static_cast<std::uint64_t>(this->population.size()));
+            for (const auto& individual : this->population) {
+                write(individual.penalty);
+                write(static_cast<std::uint8_t>(individual.overThreshold));
+                write(static_cast<std::uint64_t>(individual.genes.size()));
+                for (const auto& gene : individual.genes) {
+                    write(static_cast<std::uint32_t>(gene.oper - operators.data()));
+                    write(gene.value);
+                }
+            }
+
+            if (!file) return false;
+        }
+
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // Genes will point into operators, which has to outlive the checkpoint
+    bool load(const std::string& path, const std::vector<GPOperator<T, Context>>& operators) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        auto read = [&file](auto& value) {
+            file.read(reinterpret_cast<char*>(&value), sizeof(value));
+            return static_cast<bool>(file);
+        };
+        auto readString = [&](std::string& value) {
+            std::uint64_t size;
+            if (!read(size) || size > (1 << 20)) return false;
+            value.resize(size);
+            file.read(value.data(), size);
+            return static_cast<bool>(file);
+        };
+
+        char header[sizeof(magic)];
+        std::uint64_t valueSize;
+        std::uint64_t operatorsCount;
+        file.read(header, sizeof(header));
+        if (!file || std::memcmp(header, magic, sizeof(magic)) != 0) return false;
+        if (!read(valueSize) || valueSize != sizeof(T)) return false;
+        if (!read(operatorsCount) || operatorsCount != operators.size()) return false;
+        std::string symbol;
+        for (const auto& oper : operators) {
+            if (!readString(symbol) || symbol != oper.symbol) return false;
+        }
+
+        if (!read(this->costEvaluations) || !read(this->duplicates) || !read(this->rejected) || !read(this->abortedEvaluations) ||
+            !read(this->improvedByTuning) || !read(this->generationsSinceTuning) || !readString(this->rng)) return false;
+
+        std::uint64_t populationSize;
+        if (!read(populationSize)) return false;
+        this->population.clear();
+        for (std::uint64_t i = 0 ; i < populationSize ; i++) {
+            GPMigrant<T, Context> individual;
+            std::uint8_t overThreshold;
+            std::uint64_t genesCount;
+            if (!read(individual.penalty) || !read(overThreshold) || !read(genesCount) || genesCount == 0) return false;
+            individual.overThreshold = overThreshold != 0;
+
+            individual.genes.resize(genesCount);
+            for (auto& gene : individual.genes) {
+                std::uint32_t index;
+                if (!read(index) || index >= operators.size() || !read(gene.value)) return false;
+                gene.oper = &operators[index];
+            }
+            if (!this->recalculate(individual.genes)) return false;
+            this->population.push_back(std::move(individual));
+        }
+
+        return true;
+    }
+
+    // Fills in extents, depths and hashes from the back, children come after their parent; false if the genes aren't exactly one tree
+    static bool recalculate(std::vector<GPGene<T, Context>>& genes) {
+        std::size_t pending = 1;    // Subtrees still to be read in prefix order
+        for (const auto& gene : genes) {
+            if (pending == 0) return false;
+            pending = pending - 1 + gene.oper->arity;
+        }
+        if (pending != 0) return false;
+
+        for (std::size_t index = genes.size() ; index-- > 0 ; ) {
+            GPHash hash(genes[index].oper, genes[index].value);
+            std::uint32_t size = 1;
+            std::uint32_t depth = 0;
+            std::size_t child = index + 1;
+            for (std::size_t i = 0 ; i < genes[index].oper->arity ; i++) {
+                size += genes[child].subtreeSize;
+                depth = std::max(depth, genes[child].subtreeDepth);
+                hash.add(genes[child].hash);
+                child += genes[child].subtreeSize;
+            }
+            genes[index].subtreeSize = size;
+            genes[index].subtreeDepth = depth + 1;
+            genes[index].hash = hash.get();
+        }
+        return true;
+    }
+};
+
+template <typename T, typename Context>
+class GP {
+    friend struct GPBenchmark;  // benchmark.cpp times the private variation operators in isolation
+
+    private:
+        std::vector<GPNode<T, Context>*> population;
+        std::vector<GPNode<T, Context>*> nextPopulation;   // Reused buffer for newGeneration
+        std::size_t populationSize;
+
+        /*
+            Trees of two consecutive generations live in two arenas
+            A new generation is built in the other arena, which only held the generation before the current one
+        */
+        GPArena arenas[2];
+        std::size_t activeArena = 0;   // New nodes are allocated here
+
+        GPGenerator<T, Context> generator;
+        std::vector<GPGene<T, Context>> genes;  // Scratch buffer for generated trees
+
+        std::size_t costEvaluations;
+        std::size_t maxTreeDepth;
+        std::size_t maxTreeNodes;
+        std::size_t tournamentSize;
+        std::size_t elitism;
+        double pClone;
+        double pMutate;
+        double pCross;
+
+        IPenalty<T, Context>* penalty;
+
+        /*
+            Offspring are only scheduled for evaluation during variation, all of them are evaluated at once afterwards
+            Variation stays on the single rng, so a fixed seed gives the same run for any number of threads
+        */
+        ThreadPool pool;
+        std::vector<GPProgram<T, Context>> programs;    // Scratch program for every worker, recompiled for every evaluated tree
+        std::vector<GPNode<T, Context>*> unevaluated;
+
+        std::vector<std::size_t> competitors;   // Scratch space for tournament
+        bool steadyState = false;               // See setSteadyState
+        std::vector<GPNode<T, Context>*> offspring;     // Scratch space for steadyStateGeneration
+        static constexpr std::size_t steadyStateBatch = 32;     // Offspring evaluated together in steady state, fixed so runs don't depend on the thread count
+
+        std::unique_ptr<GPSubtreeCache<T>> cache;   // Optional, see enableSubtreeCache
+
+        /*
+            Offspring equal (by canonical hash) to a parent or to an earlier offspring of the same generation aren't evaluated,
+            they take over their twin's penalty and don't count as cost evaluations
+        */
+        std::unordered_map<std::uint64_t, std::pair<double, bool>> parentPenalties;    // (penalty, over threshold)
+        std::unordered_map<std::uint64_t, GPNode<T, Context>*> scheduled;  // First offspring with each hash in this generation
+        std::vector<std::pair<GPNode<T, Context>*, GPNode<T, Context>*>> twins;    // (duplicate, scheduled twin)
+        bool rejectDuplicates = false;
+        std::size_t rejectedThisGeneration = 0;
+        std::size_t duplicates = 0;
+        std::size_t rejected = 0;
+
+        /*
+            With early abort, an offspring's evaluation stops once it's penalty exceeds the k-th worst penalty of it's parents' generation,
+            it would lose practically every tournament anyway. It's penalty is then only a lower bound (see GPNode::isOverThreshold)
+        */
+        std::size_t earlyAbort = 0;     // k, 0 disables
+        double cutoff = std::numeric_limits<double>::infinity();
+        std::vector<char> aborted;      // Per scheduled tree, written by the workers
+        std::size_t abortedEvaluations = 0;
+
+        // Constant tuning, see setConstantTuning
+        std::size_t tunedIndividuals = 0;   // 0 disables
+        std::size_t tuningInterval = 1;
+        std::size_t tuningPasses = 0;
+        std::size_t generationsSinceTuning = 0;
+        std::vector<GPConstantTuner<T, Context>> tuners;            // Per worker
+        std::vector<std::vector<GPGene<T, Context>>> tunedGenes;    // Per worker
+        std::vector<GPNode<T, Context>*> tuned;
+        std::vector<std::size_t> tuningEvaluations;     // Per tuned tree, written by the workers
+        std::vector<char> tuningImproved;               // Per tuned tree, written by the workers
+        std::size_t improvedByTuning = 0;
+
+        GPSelection selection = GPSelection::PENALTY;
+        std::vector<GPNode<T, Context>*> sortScratch;
+        std::vector<double> penalties;  // Scratch space for the early abort cutoff and telemetry
+
+        // Telemetry, see setTelemetry
+        std::function<void(const GPGenerationStats&)> telemetry;
+        GPPhaseTimer timer;
+        GPGenerationStats stats;
+        std::size_t generation = 0;
+        std::size_t generationAllocations = 0;  // Arena allocations of the current generation
+
+        Context context;
+
+        std::mt19937 rng;
+        std::uniform_real_distribution<double> probDist;
+
+        GPArena& arena() {
+            return this->arenas[this->activeArena];
+        }
+
+        // Builds the tree encoded by the prefix-order genes starting at gene, which is moved past it
+        GPNode<T, Context>* build(const GPGene<T, Context>*& gene, GPNode<T, Context>* parent = nullptr) {
+            const GPGene<T, Context>& g = *gene;
+            gene++;
+
+            GPArena& arena = this->arena();
+            GPNode<T, Context>** children = arena.createArray<GPNode<T, Context>*>(g.oper->arity);
+            GPNode<T, Context>* node = arena.create<GPNode<T, Context>>(g.oper, children, parent);
+            node->value = g.value;
+            node->subtreeSize = g.subtreeSize;
+            node->subtreeDepth = g.subtreeDepth;
+            node->hash = g.hash;
+
+            for (std::size_t i = 0 ; i < g.oper->arity ; i++) {
+                node->setChild(i, this->build(gene, node));
             }
             return node;
         }
 
-        std::unique_ptr<GPNode<T, Context>> mutate(GPNode<T, Context>* tree) {
-            std::unique_ptr<GPNode<T, Context>> mutatedTree = tree->clone();
-            auto p = mutatedTree->getRandomNode();
+        GPNode<T, Context>* full(std::size_t maxDepth, std::size_t maxNodes) {
+            this->genes.clear();
+            this->generator.full(this->genes, maxDepth, maxNodes, this->rng);
+            const GPGene<T, Context>* gene = this->genes.data();
+            return this->build(gene);
+        }
+
+        GPNode<T, Context>* grow(std::size_t maxDepth, std::size_t maxNodes, GPNode<T, Context>* parent = nullptr, bool banTerminals = false) {
+            this->genes.clear();
+            this->generator.grow(this->genes, maxDepth, maxNodes, this->rng, banTerminals);
+            const GPGene<T, Context>* gene = this->genes.data();
+            return this->build(gene, parent);
+        }
+
+        void requestCached(GPNode<T, Context>* node, const GPNode<T, Context>* root) {
+            if (this->cache->request(node->getHash(), node->getSubtreeSize(), root)) return;
+            for (GPNode<T, Context>* child : node->getChildren()) {
+                this->requestCached(child, root);
+            }
+        }
+
+        // Returns false if the tree was rejected as a duplicate, it must not be added to the population then
+        bool schedule(GPNode<T, Context>* tree, bool mayReject) {
+            std::uint64_t hash = tree->getHash();
+            auto parent = this->parentPenalties.find(hash);
+            auto twin = this->scheduled.find(hash);
+            bool duplicate = parent != this->parentPenalties.end() || twin != this->scheduled.end();
+
+            // Never reject more than a population worth of offspring, there might not be anything else left to find
+            if (duplicate && mayReject && this->rejectDuplicates && this->rejectedThisGeneration < this->populationSize) {
+                this->rejectedThisGeneration++;
+                this->rejected++;
+                return false;
+            }
+
+            if (parent != this->parentPenalties.end()) {
+                tree->setPenalty(parent->second.first, parent->second.second);
+                this->duplicates++;
+            } else if (twin != this->scheduled.end()) {
+                this->twins.push_back(std::make_pair(tree, twin->second));
+                this->duplicates++;
+            } else {
+                this->scheduled.emplace(hash, tree);
+                this->unevaluated.push_back(tree);
+            }
+            return true;
+        }
+
+        // Evaluates every scheduled tree in parallel, the penalty function must be safe to call from several threads
+        void evaluateScheduled() {
+            if (this->cache) {
+                this->cache->beginBatch();
+                for (GPNode<T, Context>* tree : this->unevaluated) {
+                    this->requestCached(tree, tree);
+                }
+            }
+
+            this->penalty->prepare();
+            this->aborted.assign(this->unevaluated.size(), false);
+            this->pool.parallelFor(this->unevaluated.size(), [this](std::size_t index, std::size_t worker) {
+                GPProgram<T, Context>& program = this->programs[worker];
+                GPNode<T, Context>* tree = this->unevaluated[index];
+                program.compile(*tree, this->cache.get());
+                bool aborted;
+                double penalty = this->penalty->calculate(this->context, program, this->cutoff, aborted);
+                this->aborted[index] = aborted;
+                tree->setPenalty(penalty, aborted);
+            });
+
+            std::unordered_set<const void*> incomplete;
+            for (std::size_t i = 0 ; i < this->unevaluated.size() ; i++) {
+                if (this->aborted[i]) incomplete.insert(this->unevaluated[i]);
+            }
+            if (this->cache) this->cache->commit(incomplete);
+            this->abortedEvaluations += incomplete.size();
+            this->costEvaluations += this->unevaluated.size();
+            this->unevaluated.clear();
+
+            for (const auto& twin : this->twins) {
+                twin.first->setPenalty(twin.second->getPenalty(), twin.second->isOverThreshold());
+            }
+            this->twins.clear();
+            this->scheduled.clear();
+        }
+
+        GPNode<T, Context>* mutate(GPNode<T, Context>* tree) {
+            GPNode<T, Context>* mutatedTree = tree->clone(this->arena());
+            auto p = mutatedTree->getRandomNode(this->rng);
             GPNode<T, Context>* subtreeToRemove = p.first;
             std::size_t removalIndex = p.second;
 
-            std::unique_ptr<GPNode<T, Context>> newSubtree = this->grow(
+            GPNode<T, Context>* newSubtree = this->grow(
                 this->maxTreeDepth - mutatedTree->getSubtreeDepth() + subtreeToRemove->getSubtreeDepth(),
                 this->maxTreeNodes - mutatedTree->getSubtreeSize() + subtreeToRemove->getSubtreeSize(),
                 subtreeToRemove->getParent()
             );
 
-            subtreeToRemove->getParent()->setChild(removalIndex, std::move(newSubtree));
+            subtreeToRemove->getParent()->setChild(removalIndex, newSubtree);
             mutatedTree->recalculateSubtreeSizes();
 
-            mutatedTree->setPenalty(this->penalty->calculate(this->contexts, *mutatedTree));
-            this->costEvaluations++;
-
             return mutatedTree;
         }
 
         // If crossing fails for a child (exceeded max depth or node count) then return nullptr
-        std::pair<std::unique_ptr<GPNode<T, Context>>, std::unique_ptr<GPNode<T, Context>>> cross(GPNode<T, Context>* parent1, GPNode<T, Context>* parent2) {
-            std::unique_ptr<GPNode<T, Context>> child1 = parent1->clone();
-            std::unique_ptr<GPNode<T, Context>> child2 = parent2->clone();
+        std::pair<GPNode<T, Context>*, GPNode<T, Context>*> cross(GPNode<T, Context>* parent1, GPNode<T, Context>* parent2) {
+            GPNode<T, Context>* child1 = parent1->clone(this->arena());
+            GPNode<T, Context>* child2 = parent2->clone(this->arena());
 
-            auto p1 = child1->getRandomNode();
-            auto p2 = child2->getRandomNode();
+            auto p1 = child1->getRandomNode(this->rng);
+            auto p2 = child2->getRandomNode(this->rng);
 
             // Switch nodes between trees
             std::swap(p1.first->getParent()->children[p1.second], p2.first->getParent()->children[p2.second]);
@@ -346,40 +1523,177 @@ class GP {
 
             if (child1Invalid) {
                 child2->recalculateSubtreeSizes();
-                child2->setPenalty(this->penalty->calculate(this->contexts, *child2));
-                this->costEvaluations++;
-                return std::make_pair(std::move(child2), nullptr);
+                return std::make_pair(child2, nullptr);
             }
 
             if (child2Invalid) {
                 child1->recalculateSubtreeSizes();
-                child1->setPenalty(this->penalty->calculate(this->contexts, *child1));
-                this->costEvaluations++;
-                return std::make_pair(std::move(child1), nullptr);
+                return std::make_pair(child1, nullptr);
             }
 
             child1->recalculateSubtreeSizes();
             child2->recalculateSubtreeSizes();
-            child1->setPenalty(this->penalty->calculate(this->contexts, *child1));
-            child2->setPenalty(this->penalty->calculate(this->contexts, *child2));
-            this->costEvaluations += 2;
-            return std::make_pair(std::move(child1), std::move(child2));
+            return std::make_pair(child1, child2);
+        }
+
+        std::pair<GPNode<T, Context>*, GPNode<T, Context>*> tournament() {
+            auto winners = gpTournament(this->populationSize, this->tournamentSize, this->competitors, this->rng);
+            return std::make_pair(this->population[winners.first], this->population[winners.second]);
         }
 
-        std::vector<GPNode<T, Context>*> tournament(std::size_t winnersCount) {
-            std::shuffle(population.begin(), population.end(), rng);
-            std::vector<GPNode<T, Context>*> competitors;
-            for (std::size_t i = 0 ; i < this->tournamentSize ; i++) {
-                competitors.push_back(population[i].get());
+        // Copies the CONST values of genes (the tree's own prefix order) back into it's nodes, gene is moved past the tree
+        void setConstants(GPNode<T, Context>* node, const GPGene<T, Context>*& gene) {
+            if (node->oper->opcode == GPOpcode::CONST) node->value = gene->value;
+            gene++;
+            for (GPNode<T, Context>* child : node->getChildren()) {
+                this->setConstants(child, gene);
             }
+        }
 
-            std::sort(competitors.begin(), competitors.end(),
+        // Tuned constants are kept only if the penalty improved, the trees are changed in place
+        void tuneConstants() {
+            if (this->tunedIndividuals == 0 || ++this->generationsSinceTuning < this->tuningInterval) return;
+            this->generationsSinceTuning = 0;
+            const T* targets = this->penalty->getTargets(this->context);
+            if (targets == nullptr) return;
+
+            std::size_t count = std::min(this->tunedIndividuals, this->populationSize);
+            this->tuned.assign(this->population.begin(), this->population.end());
+            std::partial_sort(this->tuned.begin(), this->tuned.begin() + count, this->tuned.end(),
                 [](const auto& a, const auto& b) {
                     return a->getPenalty() < b->getPenalty();
                 }
             );
+            this->tuningEvaluations.assign(count, 0);
+            this->tuningImproved.assign(count, 0);
+
+            this->penalty->prepare();
+            this->pool.parallelFor(count, [this, targets](std::size_t index, std::size_t worker) {
+                GPNode<T, Context>* tree = this->tuned[index];
+                std::vector<GPGene<T, Context>>& genes = this->tunedGenes[worker];
+                genes.clear();
+                tree->toGenes(genes);
+
+                bool improved;
+                this->tuningEvaluations[index] = this->tuners[worker].tune(genes, this->context, targets, this->tuningPasses, improved);
+                if (!improved) return;
+
+                GPProgram<T, Context>& program = this->programs[worker];
+                program.compile(std::span<const GPGene<T, Context>>(genes));
+                double penalty = this->penalty->calculate(this->context, program);
+                this->tuningEvaluations[index]++;
+                if (!(penalty < tree->getPenalty())) return;
+
+                const GPGene<T, Context>* gene = genes.data();
+                this->setConstants(tree, gene);
+                tree->recalculateSubtreeSizes();
+                tree->setPenalty(penalty);
+                this->tuningImproved[index] = 1;
+            });
+
+            for (std::size_t i = 0 ; i < count ; i++) {
+                this->costEvaluations += this->tuningEvaluations[i];
+                this->improvedByTuning += this->tuningImproved[i];
+            }
+        }
 
-            return std::vector<GPNode<T, Context>*>(competitors.begin(), competitors.begin() + winnersCount);
+        // Replaces the worst individual of the sorted population, keeping it sorted
+        void insertSorted(GPNode<T, Context>* tree) {
+            this->population.pop_back();
+            auto position = std::upper_bound(this->population.begin(), this->population.end(), tree->getPenalty(),
+                [](double penalty, GPNode<T, Context>* node) {
+                    return penalty < node->getPenalty();
+                }
+            );
+            this->population.insert(position, tree);
+        }
+
+        void sortPopulation() {
+            std::sort(this->population.begin(), this->population.end(),
+                [](const auto& a, const auto& b) {
+                    return a->getPenalty() < b->getPenalty();
+                }
+            );
+        }
+
+        /*
+            populationSize breeding steps, whose offspring replace the worst individual (unless they're even worse).
+            Offspring are bred from the current population steadyStateBatch at a time and each batch is evaluated at once on the thread pool.
+            Duplicates are detected as in newGeneration, against everything that was in the population during this generation.
+            With early abort the worst penalty is the evaluation cutoff, since anything above it is thrown away anyway
+        */
+        void steadyStateGeneration() {
+            this->sortPopulation();
+
+            this->parentPenalties.clear();
+            for (GPNode<T, Context>* tree : this->population) {
+                this->parentPenalties.emplace(tree->getHash(), std::make_pair(tree->getPenalty(), tree->isOverThreshold()));
+            }
+            this->rejectedThisGeneration = 0;
+            this->timer.charge(GPPhase::SELECTION);
+
+            for (std::size_t step = 0 ; step < this->populationSize ; ) {
+                this->offspring.clear();
+                for ( ; step < this->populationSize && this->offspring.size() < steadyStateBatch ; step++) {
+                    double roll = probDist(rng);
+                    if (roll < this->pClone) {  // Clone, keeps it's parent's penalty
+                        GPNode<T, Context>* parent = this->tournament().first;
+                        this->timer.charge(GPPhase::SELECTION);
+                        this->offspring.push_back(parent->clone(this->arena()));
+                    } else if (roll < this->pClone + this->pMutate) {   // Mutate
+                        GPNode<T, Context>* parent = this->tournament().first;
+                        this->timer.charge(GPPhase::SELECTION);
+                        GPNode<T, Context>* child = this->mutate(parent);
+                        if (this->schedule(child, true)) this->offspring.push_back(child);
+                    } else {    // Cross
+                        auto parents = this->tournament();
+                        this->timer.charge(GPPhase::SELECTION);
+                        auto p = this->cross(parents.first, parents.second);
+                        if (p.first != nullptr && this->schedule(p.first, true)) this->offspring.push_back(p.first);
+                        if (p.second != nullptr && this->schedule(p.second, true)) this->offspring.push_back(p.second);
+                    }
+                    this->timer.charge(GPPhase::VARIATION);
+                }
+
+                if (this->earlyAbort != 0) this->cutoff = this->population.back()->getPenalty();
+                this->evaluateScheduled();
+                this->timer.charge(GPPhase::EVALUATION);
+
+                for (GPNode<T, Context>* child : this->offspring) {
+                    if (child->isOverThreshold() || child->getPenalty() > this->population.back()->getPenalty()) continue;
+                    this->insertSorted(child);
+                    this->parentPenalties.emplace(child->getHash(), std::make_pair(child->getPenalty(), false));
+                }
+                this->timer.charge(GPPhase::SELECTION);
+            }
+
+            // Everything alive is in the active arena together with the discarded offspring, so the survivors move to the other one
+            this->generationAllocations = this->arena().getAllocations();
+            this->activeArena = 1 - this->activeArena;
+            this->arena().reset();
+            for (GPNode<T, Context>*& tree : this->population) {
+                tree = tree->clone(this->arena());
+            }
+            this->generationAllocations += this->arena().getAllocations();
+            this->timer.charge(GPPhase::VARIATION);
+
+            this->tuneConstants();
+            this->timer.charge(GPPhase::EVALUATION);
+        }
+
+        void emitTelemetry(std::size_t evaluationsBefore) {
+            this->stats.generation = ++this->generation;
+            this->stats.costEvaluations = this->costEvaluations;
+            this->stats.generationEvaluations = this->costEvaluations - evaluationsBefore;
+            gpSummarize(this->population, this->penalties, this->stats, [](GPNode<T, Context>* tree) {
+                return std::make_tuple(tree->getPenalty(), tree->getSubtreeSize(), tree->getSubtreeDepth());
+            });
+            this->stats.selectionSeconds = this->timer.get(GPPhase::SELECTION);
+            this->stats.variationSeconds = this->timer.get(GPPhase::VARIATION);
+            this->stats.evaluationSeconds = this->timer.get(GPPhase::EVALUATION);
+            this->stats.arenaAllocations = this->generationAllocations;
+            this->stats.reservedBytes = this->arenas[0].getReservedBytes() + this->arenas[1].getReservedBytes();
+            this->telemetry(this->stats);
         }
 
     public:
@@ -393,10 +1707,15 @@ class GP {
             double pClone,
             double pMutate,
             double pCross,
+            T constantMin,
+            T constantMax,
             IPenalty<T, Context>* penalty,
-            std::vector<Context> contexts
+            const Context& context,
+            std::size_t threads = 1,
+            std::mt19937::result_type seed = std::random_device{}()
         ) :
         populationSize(populationSize),
+        generator(operators, maxTreeDepth, maxTreeNodes, constantMin, constantMax),
         costEvaluations(0),
         maxTreeDepth(maxTreeDepth),
         maxTreeNodes(maxTreeNodes),
@@ -406,113 +1725,431 @@ class GP {
         pMutate(pMutate),
         pCross(pCross),
         penalty(penalty),
-        contexts(contexts),
-        rng(std::random_device{}()),
+        pool(threads),
+        programs(pool.size()),
+        context(context),
+        rng(seed),
         probDist(0.0, 1.0) {
             this->population.resize(populationSize);
+        }
 
-            this->operators = operators;
-            std::sort(this->operators.begin(), this->operators.end(),
-                [](auto const& a, auto const& b) {
-                    return a.arity < b.arity;
+        std::size_t getCostEvaluations() {
+            return this->costEvaluations;
+        }
+
+        /*
+            Keeps the outputs of evaluated subtrees (keyed by their structural hash) within maxBytes, so later trees sharing them skip the work
+            The penalty function has to evaluate every sample in a single pass
+        */
+        void enableSubtreeCache(std::size_t maxBytes) {
+            this->cache = std::make_unique<GPSubtreeCache<T>>(this->context.getRows(), maxBytes);
+        }
+
+        const GPSubtreeCache<T>* getSubtreeCache() const {
+            return this->cache.get();
+        }
+
+        // Mutated and crossed offspring that duplicate a parent or another offspring are discarded and replaced, to keep the population diverse
+        void setRejectDuplicates(bool rejectDuplicates) {
+            this->rejectDuplicates = rejectDuplicates;
+        }
+
+        // Offspring that reused a twin's penalty instead of being evaluated
+        std::size_t getDuplicates() const {
+            return this->duplicates;
+        }
+
+        std::size_t getRejected() const {
+            return this->rejected;
+        }
+
+        // In steady-state mode newGeneration creates populationSize offspring in small batches, each one replacing the worst individual once it's batch is evaluated
+        void setSteadyState(bool steadyState) {
+            this->steadyState = steadyState;
+        }
+
+        // Pareto selection only applies to generational replacement, steady-state replacement always compares penalties
+        void setSelection(GPSelection selection) {
+            this->selection = selection;
+        }
+
+        // Abort offspring evaluations once they're worse than the k-th worst individual of the current population, 0 disables
+        void setEarlyAbort(std::size_t k) {
+            this->earlyAbort = std::min(k, this->populationSize);
+        }
+
+        std::size_t getAbortedEvaluations() const {
+            return this->abortedEvaluations;
+        }
+
+        /*
+            Every interval generations the constants of the best individuals are tuned (see GPConstantTuner), with at most passes passes
+            over the training set each. Every pass counts as a cost evaluation. Needs IPenalty::getTargets, 0 individuals disables
+        */
+        void setConstantTuning(std::size_t individuals, std::size_t interval = 1, std::size_t passes = 10) {
+            this->tunedIndividuals = individuals;
+            this->tuningInterval = std::max<std::size_t>(interval, 1);
+            this->tuningPasses = passes;
+            this->tuners.resize(this->pool.size());
+            this->tunedGenes.resize(this->pool.size());
+        }
+
+        // Tunings that improved an individual's penalty
+        std::size_t getImprovedByTuning() const {
+            return this->improvedByTuning;
+        }
+
+        /*
+            callback receives a GPGenerationStats record at the end of every generation (e.g. GPTelemetryWriter::write).
+            Phases are only timed while a callback is set, an empty callback disables telemetry
+        */
+        void setTelemetry(std::function<void(const GPGenerationStats&)> callback) {
+            this->telemetry = std::move(callback);
+        }
+
+        const std::vector<GPOperator<T, Context>>& getOperators() const {
+            return this->generator.getOperators();
+        }
+
+        std::vector<GPMigrant<T, Context>> getBest(std::size_t k) {
+            k = std::min(k, this->populationSize);
+            std::vector<GPNode<T, Context>*> sorted(this->population);
+            std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end(),
+                [](const auto& a, const auto& b) {
+                    return a->getPenalty() < b->getPenalty();
                 }
             );
-            
-            this->maxArity = this->operators.back().arity;
 
-            this->operCountUpToArity.resize(this->maxArity + 1);
-            for (const auto& oper : this->operators) {
-                this->operCountUpToArity[oper.arity]++;
-                if (this->minNonZeroArity == -1 && oper.arity != 0) this->minNonZeroArity = oper.arity;
+            std::vector<GPMigrant<T, Context>> migrants(k);
+            for (std::size_t i = 0 ; i < k ; i++) {
+                sorted[i]->toGenes(migrants[i].genes);
+                migrants[i].penalty = sorted[i]->getPenalty();
+                migrants[i].overThreshold = sorted[i]->isOverThreshold();
             }
+            return migrants;
+        }
 
-            std::size_t count = 0;
-            for (std::size_t i = 0 ; i <= this->maxArity ; i++) {
-                this->operCountUpToArity[i] += count;
-                count = this->operCountUpToArity[i];
-            }
+        // Migrants replace the worst individuals and keep their penalties, their genes have to point into this GP's operator table
+        void replaceWorst(const std::vector<GPMigrant<T, Context>>& migrants) {
+            std::size_t k = std::min(migrants.size(), this->populationSize);
+            std::nth_element(this->population.begin(), this->population.end() - k, this->population.end(),
+                [](const auto& a, const auto& b) {
+                    return a->getPenalty() < b->getPenalty();
+                }
+            );
 
-            std::size_t geoSum = 1;
-            minArityGeometricSeries.push_back(geoSum);
-            for (std::size_t N = 1; N < 20 ; N++) {
-                geoSum *= this->minNonZeroArity;
-                this->minArityGeometricSeries.push_back(this->minArityGeometricSeries[N-1] + geoSum);
+            for (std::size_t i = 0 ; i < k ; i++) {
+                const GPGene<T, Context>* gene = migrants[i].genes.data();
+                GPNode<T, Context>* tree = this->build(gene);
+                tree->recalculateSubtreeSizes();    // Hashes depend on the operator table
+                tree->setPenalty(migrants[i].penalty, migrants[i].overThreshold);
+                this->population[this->populationSize - k + i] = tree;
             }
+        }
 
-            // Find the highest depth for full init (using only minimal non-zero arity operators)
-            for (std::size_t d = this->maxTreeDepth ; d > 1 ; d--) {
-                if (this->maxTreeNodes >= this->minArityGeometricSeries[d-1]) {
-                    this->maxDepthFull = d;
-                    break;
-                }
+        GPCheckpoint<T, Context> getCheckpoint() {
+            GPCheckpoint<T, Context> checkpoint;
+            checkpoint.population.resize(this->populationSize);
+            for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+                this->population[i]->toGenes(checkpoint.population[i].genes);
+                checkpoint.population[i].penalty = this->population[i]->getPenalty();
+                checkpoint.population[i].overThreshold = this->population[i]->isOverThreshold();
             }
+
+            checkpoint.costEvaluations = this->costEvaluations;
+            checkpoint.duplicates = this->duplicates;
+            checkpoint.rejected = this->rejected;
+            checkpoint.abortedEvaluations = this->abortedEvaluations;
+            checkpoint.improvedByTuning = this->improvedByTuning;
+            checkpoint.generationsSinceTuning = this->generationsSinceTuning;
+            std::ostringstream rng;
+            rng << this->rng;
+            checkpoint.rng = rng.str();
+            return checkpoint;
         }
 
-        std::size_t getCostEvaluations() {
-            return this->costEvaluations;
+        /*
+            Continues the saved run instead of initializePopulation, the checkpoint has to be loaded with this GP's operator table.
+            Returns false if the population size differs
+        */
+        bool restore(const GPCheckpoint<T, Context>& checkpoint) {
+            if (checkpoint.population.size() != this->populationSize) return false;
+            std::istringstream rng(checkpoint.rng);
+            rng >> this->rng;
+            if (!rng) return false;
+
+            for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+                const GPGene<T, Context>* gene = checkpoint.population[i].genes.data();
+                this->population[i] = this->build(gene);
+                this->population[i]->setPenalty(checkpoint.population[i].penalty, checkpoint.population[i].overThreshold);
+            }
+
+            this->costEvaluations = checkpoint.costEvaluations;
+            this->duplicates = checkpoint.duplicates;
+            this->rejected = checkpoint.rejected;
+            this->abortedEvaluations = checkpoint.abortedEvaluations;
+            this->improvedByTuning = checkpoint.improvedByTuning;
+            this->generationsSinceTuning = checkpoint.generationsSinceTuning;
+            return true;
         }
 
         GPNode<T, Context>& getBestSolution() {
             auto bestIt = std::min_element(
                 this->population.begin(),
                 this->population.end(),
-                [](const std::unique_ptr<GPNode<T, Context>>& a,
-                const std::unique_ptr<GPNode<T, Context>>& b) {
+                [](GPNode<T, Context>* a,
+                GPNode<T, Context>* b) {
                     return a->getPenalty() < b->getPenalty();
                 }
             );
 
-            return *bestIt->get();
+            return **bestIt;
         }
 
-        void initializePopulation() {   // Ramped half-and-half
+        /*
+            Ramped half-and-half. For a warm start the first individuals are taken from seeds (in order, e.g. the population of an earlier run),
+            their saved penalties are ignored since everything is evaluated
+        */
+        void initializePopulation(const std::vector<GPMigrant<T, Context>>& seeds = {}) {
             for (std::size_t i = this->populationSize / 2 ; i < this->populationSize ; i++) {
                 population[i] = this->grow(2 + i % (this->maxTreeDepth - 1), this->maxTreeNodes, nullptr, true); // Depth is in [0, maxTreeDepth]
             }
 
             for (std::size_t i = 0; i < this->populationSize / 2 ; i++) {
-                population[i] = this->full(2 + i % (this->maxDepthFull - 1), this->maxTreeNodes); // Depth is in [0, maxDepthFull]
+                population[i] = this->full(2 + i % (this->generator.getMaxDepthFull() - 1), this->maxTreeNodes); // Depth is in [0, maxDepthFull]
             }
 
-            for (const auto& node : population) {
-                node->recalculateSubtreeSizes();
-                node->setPenalty(this->penalty->calculate(this->contexts, *node));
-                this->costEvaluations++;
+            for (std::size_t i = 0 ; i < std::min(seeds.size(), this->populationSize) ; i++) {
+                const GPGene<T, Context>* gene = seeds[i].genes.data();
+                population[i] = this->build(gene);
             }
+
+            for (GPNode<T, Context>* tree : this->population) {
+                this->schedule(tree, false);
+            }
+            this->evaluateScheduled();
         }
 
         void newGeneration() {
-            std::vector<std::unique_ptr<GPNode<T, Context>>> newPopulation;
+            std::size_t evaluationsBefore = this->costEvaluations;
+            this->timer.begin(static_cast<bool>(this->telemetry));
 
-            // Sort by fitness for elitism
-            std::sort(this->population.begin(), this->population.end(),
-                [](const auto& a, const auto& b) {
-                    return a->getPenalty() < b->getPenalty();
-                }
-            );
+            if (this->steadyState) {
+                this->steadyStateGeneration();
+                if (this->telemetry) this->emitTelemetry(evaluationsBefore);
+                return;
+            }
+
+            std::vector<GPNode<T, Context>*>& newPopulation = this->nextPopulation;
+            newPopulation.clear();
+
+            // The other arena holds the previous generation, which is no longer referenced
+            this->activeArena = 1 - this->activeArena;
+            this->arena().reset();
+
+            // Sort by fitness for elitism and tournaments
+            if (this->selection == GPSelection::PARETO) {
+                gpParetoSort(this->population, this->sortScratch, [](GPNode<T, Context>* tree) {
+                    return std::make_pair(tree->getPenalty(), tree->getSubtreeSize());
+                });
+            } else {
+                this->sortPopulation();
+            }
+
+            this->parentPenalties.clear();
+            for (GPNode<T, Context>* tree : this->population) {
+                this->parentPenalties.emplace(tree->getHash(), std::make_pair(tree->getPenalty(), tree->isOverThreshold()));
+            }
+            this->rejectedThisGeneration = 0;
+
+            if (this->earlyAbort != 0) {
+                this->penalties.clear();
+                for (GPNode<T, Context>* tree : this->population) this->penalties.push_back(tree->getPenalty());
+                std::nth_element(this->penalties.begin(), this->penalties.end() - this->earlyAbort, this->penalties.end());
+                this->cutoff = this->penalties[this->populationSize - this->earlyAbort];
+            }
+            this->timer.charge(GPPhase::SELECTION);
 
             for (std::size_t i = 0 ; i < this->elitism ; i++) {
-                newPopulation.push_back(this->population[i]->clone());
+                newPopulation.push_back(this->population[i]->clone(this->arena()));
             }
+            this->timer.charge(GPPhase::VARIATION);
 
             while (newPopulation.size() < this->populationSize) {
                 double roll = probDist(rng);
                 if (roll < this->pClone) {  // Clone
-                    newPopulation.push_back(std::move(this->tournament(1)[0]->clone()));
+                    GPNode<T, Context>* parent = this->tournament().first;
+                    this->timer.charge(GPPhase::SELECTION);
+                    newPopulation.push_back(parent->clone(this->arena()));
                 } else if (roll < this->pClone + this->pMutate) {   // Mutate
-                    newPopulation.push_back(std::move(this->mutate(this->tournament(1)[0])));
+                    GPNode<T, Context>* parent = this->tournament().first;
+                    this->timer.charge(GPPhase::SELECTION);
+                    GPNode<T, Context>* child = this->mutate(parent);
+                    if (this->schedule(child, true)) newPopulation.push_back(child);
                 } else {    // Cross
-                    auto parents = this->tournament(2);
-                    auto p = this->cross(parents[0], parents[1]);
-                    if (p.first != nullptr) {
-                        newPopulation.push_back(std::move(p.first));
+                    auto parents = this->tournament();
+                    this->timer.charge(GPPhase::SELECTION);
+                    auto p = this->cross(parents.first, parents.second);
+                    if (p.first != nullptr && this->schedule(p.first, true)) {
+                        newPopulation.push_back(p.first);
                     }
-                    if (newPopulation.size() < this->populationSize && p.second != nullptr) {
-                        newPopulation.push_back(std::move(p.second));
+                    if (newPopulation.size() < this->populationSize && p.second != nullptr && this->schedule(p.second, true)) {
+                        newPopulation.push_back(p.second);
                     }
                 }
+                this->timer.charge(GPPhase::VARIATION);
             }
+            this->generationAllocations = this->arena().getAllocations();
+
+            this->evaluateScheduled();
+            std::swap(this->population, this->nextPopulation);
+            this->tuneConstants();
+            this->timer.charge(GPPhase::EVALUATION);
+
+            if (this->telemetry) this->emitTelemetry(evaluationsBefore);
+        }
+};
+
+enum class GPTopology {
+    RING,   // Island i sends to island i + 1
+    RANDOM  // Every migration goes to a random other island
+};
 
-            this->population = std::move(newPopulation);
+/*
+    Island model: several GP populations evolve on their own threads and every migrationInterval generations
+    send copies of their best individuals to another island, where they replace the worst ones.
+    Mailboxes hold at most one pending batch of migrants and are swapped atomically, a batch that isn't picked up in time is replaced by the next one.
+    Islands run unsynchronised, so runs aren't reproducible even with a fixed seed
+*/
+template <typename T, typename Context>
+class GPIslands {
+    private:
+        std::vector<std::unique_ptr<GP<T, Context>>> islands;
+        std::unique_ptr<std::atomic<std::vector<GPMigrant<T, Context>>*>[]> mailboxes;
+        std::vector<std::mt19937> rngs;     // Migration targets of every island
+
+        std::size_t migrationInterval;
+        std::size_t migrantsCount;
+        GPTopology topology;
+
+        std::atomic<std::size_t> costEvaluations = 0;   // Over all islands
+
+        void send(std::size_t from) {
+            std::size_t to = (from + 1) % this->islands.size();
+            if (this->topology == GPTopology::RANDOM) {
+                std::uniform_int_distribution<std::size_t> dist(0, this->islands.size() - 2);
+                to = dist(this->rngs[from]);
+                if (to >= from) to++;
+            }
+
+            // Operator tables are identical and never change, so genes are moved over by index
+            const GPOperator<T, Context>* source = this->islands[from]->getOperators().data();
+            const GPOperator<T, Context>* target = this->islands[to]->getOperators().data();
+            auto* migrants = new std::vector<GPMigrant<T, Context>>(this->islands[from]->getBest(this->migrantsCount));
+            for (auto& migrant : *migrants) {
+                for (auto& gene : migrant.genes) gene.oper = target + (gene.oper - source);
+            }
+
+            delete this->mailboxes[to].exchange(migrants, std::memory_order_acq_rel);
+        }
+
+        void receive(std::size_t island) {
+            std::unique_ptr<std::vector<GPMigrant<T, Context>>> migrants(this->mailboxes[island].exchange(nullptr, std::memory_order_acq_rel));
+            if (migrants) this->islands[island]->replaceWorst(*migrants);
+        }
+
+        void runIsland(std::size_t index, std::size_t budget) {
+            GP<T, Context>& island = *this->islands[index];
+            island.initializePopulation();
+            this->costEvaluations += island.getCostEvaluations();
+
+            for (std::size_t generation = 1 ; this->costEvaluations.load() < budget ; generation++) {
+                std::size_t before = island.getCostEvaluations();
+                island.newGeneration();
+                this->costEvaluations += island.getCostEvaluations() - before;
+
+                // A converged island only reuses duplicates' penalties and would never reach the budget
+                if (island.getCostEvaluations() == before) break;
+
+                this->receive(index);
+                if (this->islands.size() > 1 && generation % this->migrationInterval == 0) this->send(index);
+            }
+        }
+
+    public:
+        // Every island gets populationSize individuals and it's own penalty, the penalties are used concurrently
+        GPIslands(
+            std::vector<GPOperator<T, Context>> operators,
+            std::size_t islandsCount,
+            std::size_t populationSize,
+            std::size_t maxTreeDepth,
+            std::size_t maxTreeNodes,
+            std::size_t tournamentSize,
+            std::size_t elitism,
+            double pClone,
+            double pMutate,
+            double pCross,
+            T constantMin,
+            T constantMax,
+            std::vector<IPenalty<T, Context>*> penalties,
+            const Context& context,
+            std::size_t migrationInterval,
+            std::size_t migrantsCount,
+            GPTopology topology,
+            std::mt19937::result_type seed = std::random_device{}()
+        ) :
+        mailboxes(new std::atomic<std::vector<GPMigrant<T, Context>>*>[islandsCount]),
+        migrationInterval(std::max<std::size_t>(migrationInterval, 1)),
+        migrantsCount(migrantsCount),
+        topology(topology) {
+            std::mt19937 seeder(seed);
+            for (std::size_t i = 0 ; i < islandsCount ; i++) {
+                this->islands.push_back(std::make_unique<GP<T, Context>>(
+                    operators, populationSize, maxTreeDepth, maxTreeNodes, tournamentSize, elitism, pClone, pMutate, pCross,
+                    constantMin, constantMax, penalties[i], context, 1, seeder()
+                ));
+                this->rngs.emplace_back(seeder());
+                this->mailboxes[i].store(nullptr);
+            }
+        }
+
+        ~GPIslands() {
+            for (std::size_t i = 0 ; i < this->islands.size() ; i++) {
+                delete this->mailboxes[i].load();
+            }
+        }
+
+        GPIslands(const GPIslands&) = delete;
+        GPIslands& operator=(const GPIslands&) = delete;
+
+        std::size_t size() const {
+            return this->islands.size();
+        }
+
+        // For per-island settings (subtree cache, duplicates, early abort), before run
+        GP<T, Context>& getIsland(std::size_t index) {
+            return *this->islands[index];
+        }
+
+        std::size_t getCostEvaluations() const {
+            return this->costEvaluations.load();
+        }
+
+        // Evolves all islands in parallel until they spent costEvaluations together, each island finishes it's current generation
+        void run(std::size_t costEvaluations) {
+            std::vector<std::thread> threads;
+            for (std::size_t i = 0 ; i < this->islands.size() ; i++) {
+                threads.emplace_back(&GPIslands<T, Context>::runIsland, this, i, costEvaluations);
+            }
+            for (std::thread& thread : threads) thread.join();
+        }
+
+        GPNode<T, Context>& getBestSolution() {
+            GPNode<T, Context>* best = &this->islands[0]->getBestSolution();
+            for (const auto& island : this->islands) {
+                GPNode<T, Context>& candidate = island->getBestSolution();
+                if (candidate.getPenalty() < best->getPenalty()) best = &candidate;
+            }
+            return *best;
         }
 };
\ No newline at end of file
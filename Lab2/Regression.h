@@ -0,0 +1,161 @@
+#pragma once
+#include "GPTree.h"
+#include "../Common/SampleMatrix.h"
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+/*
+    View of the training set in precision T, the first inputs columns are the variables x1..xN and the last one is the expected output
+    Columns are stored one after another, stride values apart (see SampleMatrix)
+*/
+template <typename T>
+struct RegressionContext {
+    const T* samples;
+    std::size_t stride;
+    std::size_t rows;
+    std::size_t inputs;
+
+    std::size_t getRows() const {
+        return rows;
+    }
+
+    const T* column(std::size_t index) const {
+        return samples + index * stride;
+    }
+
+    const T* target() const {
+        return this->column(inputs);
+    }
+};
+
+using Context = RegressionContext<double>;
+
+// Single precision copy of a SampleMatrix with the same aligned and padded column layout, for evaluating in float
+class FloatSampleMatrix {
+    private:
+        std::size_t rows;
+        std::size_t columns;
+        std::size_t stride;
+        std::vector<float, AlignedAllocator<float, SampleMatrix::alignment>> data;
+
+    public:
+        FloatSampleMatrix(const SampleMatrix& samples) : rows(samples.getRows()), columns(samples.getColumns()) {
+            constexpr std::size_t perCacheLine = SampleMatrix::alignment / sizeof(float);
+            this->stride = (rows + perCacheLine - 1) / perCacheLine * perCacheLine;
+            this->data.assign(this->stride * columns, 0.0f);
+            for (std::size_t c = 0 ; c < columns ; c++) {
+                std::copy(samples.column(c), samples.column(c) + rows, this->data.begin() + c * this->stride);
+            }
+        }
+
+        std::size_t getRows() const {return rows;}
+        std::size_t getColumns() const {return columns;}
+        std::size_t getStride() const {return stride;}
+
+        const float* column(std::size_t index) const {return data.data() + index * stride;}
+};
+
+// Every column but the last one is an input, Samples is a SampleMatrix or a FloatSampleMatrix
+template <typename T, typename Samples>
+RegressionContext<T> makeContext(const Samples& samples) {
+    return {samples.column(0), samples.getStride(), samples.getRows(), samples.getColumns() - 1};
+}
+
+/*
+    Square root of the summed squared errors, used by main and benchmark
+    Errors are summed in double whatever T is, so single precision only affects the evaluation itself
+*/
+template <typename T>
+class RegressionPenalty : public IPenalty<T, RegressionContext<T>> {
+    private:
+        static constexpr std::size_t chunkSize = 64;    // Samples between two cutoff checks, only used with a finite cutoff
+
+        /*
+            Chunks are evaluated in order of their historical error, so hopeless programs cross the cutoff as early as possible
+            The error is summed in fixed point, so the order doesn't depend on which thread finished first
+        */
+        std::vector<std::atomic<std::uint64_t>> chunkError;
+        std::vector<std::size_t> chunkOrder;
+
+        static std::uint64_t toFixed(double meanError) {
+            constexpr double limit = 1 << 22;
+            if (!(meanError < limit)) return static_cast<std::uint64_t>(limit * 1024);   // Also catches NaN
+            return static_cast<std::uint64_t>(meanError * 1024);
+        }
+
+        // Without a cutoff there's nothing to abort, so the samples go in order in full GPProgram blocks and the chunk errors are left alone
+        double calculateAll(const RegressionContext<T>& context, GPProgram<T, RegressionContext<T>>& program) {
+            constexpr std::size_t batchSize = GPProgram<T, RegressionContext<T>>::batchSize;
+            T outputs[batchSize];
+            const T* target = context.target();
+            double penalty = 0;
+
+            for (std::size_t start = 0 ; start < context.getRows() ; start += batchSize) {
+                std::size_t count = std::min(batchSize, context.getRows() - start);
+                program.evaluateBatch(context, start, count, outputs);
+                for (std::size_t i = 0 ; i < count ; i++) {
+                    double diff = static_cast<double>(outputs[i]) - target[start + i];
+                    penalty += (diff * diff);
+                }
+            }
+
+            return std::sqrt(penalty);
+        }
+
+    public:
+        RegressionPenalty(std::size_t samples) : chunkError((samples + chunkSize - 1) / chunkSize), chunkOrder(chunkError.size()) {
+            std::iota(chunkOrder.begin(), chunkOrder.end(), 0);
+        }
+
+        double calculate(const RegressionContext<T>& context, GPProgram<T, RegressionContext<T>>& program) override {
+            return this->calculateAll(context, program);
+        }
+
+        double calculate(const RegressionContext<T>& context, GPProgram<T, RegressionContext<T>>& program, double cutoff, bool& aborted) override {
+            aborted = false;
+            if (std::isinf(cutoff)) return this->calculateAll(context, program);
+
+            T outputs[chunkSize];
+            const T* target = context.target();
+            double penalty = 0;
+            double bound = cutoff * cutoff;
+
+            for (std::size_t i = 0 ; i < this->chunkOrder.size() ; i++) {
+                std::size_t chunk = this->chunkOrder[i];
+                std::size_t start = chunk * chunkSize;
+                std::size_t count = std::min(chunkSize, context.getRows() - start);
+                program.evaluateBatch(context, start, count, outputs);
+
+                double error = 0;
+                for (std::size_t j = 0 ; j < count ; j++) {
+                    double diff = static_cast<double>(outputs[j]) - target[start + j];
+                    error += (diff * diff);
+                }
+                this->chunkError[chunk].fetch_add(toFixed(error / count), std::memory_order_relaxed);
+
+                penalty += error;
+                if (penalty > bound && i + 1 < this->chunkOrder.size()) {
+                    aborted = true;     // Only if some chunks were really skipped, otherwise the penalty is exact
+                    break;
+                }
+            }
+
+            return std::sqrt(penalty);
+        }
+
+        void prepare() override {
+            std::stable_sort(this->chunkOrder.begin(), this->chunkOrder.end(),
+                [this](std::size_t a, std::size_t b) {
+                    return this->chunkError[a].load(std::memory_order_relaxed) > this->chunkError[b].load(std::memory_order_relaxed);
+                }
+            );
+        }
+
+        const T* getTargets(const RegressionContext<T>& context) override {
+            return context.target();
+        }
+};
+
+using Penalty = RegressionPenalty<double>;
\ No newline at end of file
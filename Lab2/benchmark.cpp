@@ -0,0 +1,262 @@
+// g++ -std=c++20 benchmark.cpp ../Common/SampleMatrix.cpp ../Common/ThreadPool.cpp -o benchmark -O3 -march=native -fopenmp-simd -fno-math-errno -pthread
+// Run from Lab2 (f1-f3 are read from 03-GP-podaci), every benchmark uses a fixed seed so runs are comparable
+
+#include "GPTree.h"
+#include "GPOpSet.h"
+#include "Regression.h"
+#include "../Common/SampleMatrix.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr std::mt19937::result_type seed = 42;
+
+// Every heap allocation of the program goes through these, so each benchmark can report allocations per operation
+static std::atomic<std::size_t> allocations = 0;
+
+// The replacements are a matching malloc/free pair, but GCC pairs the free below with the builtin operator new and warns
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(std::max<std::size_t>(size, 1))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;  // aligned_alloc wants a multiple of the alignment
+    if (void* p = std::aligned_alloc(align, rounded)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+#pragma GCC diagnostic pop
+
+static volatile std::size_t sink;   // Keeps the compiler from dropping results nobody reads
+
+struct Measurement {
+    double seconds;
+    std::size_t allocations;
+};
+
+template <typename Body>
+Measurement measure(Body body) {
+    std::size_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double>(end - start).count(), allocations.load() - before};
+}
+
+void printHeader(const std::string& title) {
+    std::cout << '\n' << title << '\n';
+    std::cout << std::left << std::setw(24) << "operation" << std::right << std::setw(10) << "ops"
+              << std::setw(14) << "ns/op" << std::setw(16) << "ops/s" << std::setw(12) << "allocs/op" << '\n';
+}
+
+void report(const std::string& name, std::size_t operations, const Measurement& m) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << operations
+              << std::fixed << std::setprecision(1) << std::setw(14) << m.seconds * 1e9 / operations
+              << std::setprecision(0) << std::setw(16) << operations / m.seconds
+              << std::setprecision(3) << std::setw(12) << static_cast<double>(m.allocations) / operations << '\n';
+}
+
+template <typename T = double>
+std::vector<GPOperator<T, RegressionContext<T>>> makeOperators(std::size_t inputs) {
+    std::vector<GPOperator<T, RegressionContext<T>>> operators = {
+        {"+", nullptr, 2, GPOpcode::ADD},
+        {"-", nullptr, 2, GPOpcode::SUB},
+        {"*", nullptr, 2, GPOpcode::MUL},
+        {"/", nullptr, 2, GPOpcode::DIV},
+        {"sin", nullptr, 1, GPOpcode::SIN},
+        {"cos", nullptr, 1, GPOpcode::COS},
+        {"C", nullptr, 0, GPOpcode::CONST}
+    };
+    for (std::size_t i = 0 ; i < inputs ; i++) {
+        operators.push_back({"x" + std::to_string(i + 1), nullptr, 0, GPOpcode::VAR, i});
+    }
+    return operators;
+}
+
+// y = x1 * x2 + sin(x3) - x4 / 2 on uniform inputs from [-2, 2]
+SampleMatrix makeSynthetic(std::size_t rows) {
+    constexpr std::size_t inputs = 4;
+    SampleMatrix samples(rows, inputs + 1);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-2, 2);
+    for (std::size_t i = 0 ; i < rows ; i++) {
+        for (std::size_t c = 0 ; c < inputs ; c++) samples.at(i, c) = dist(rng);
+        samples.at(i, inputs) = samples.at(i, 0) * samples.at(i, 1) + std::sin(samples.at(i, 2)) - samples.at(i, 3) / 2;
+    }
+    return samples;
+}
+
+// Friend of GP, times the operators newGeneration is built from one at a time
+struct GPBenchmark {
+    static constexpr std::size_t operations = 100000;
+    static constexpr std::size_t resetInterval = 1000;  // Operations between two resets of the scratch arena
+
+    static void variation(const SampleMatrix& samples) {
+        Context context = makeContext<double>(samples);
+        Penalty penalty(context.getRows());
+        GP<double, Context> gp(makeOperators(context.inputs), 500, 7, 50, 3, 1, 0.1, 0.5, 0.4, -1.0, 1.0, &penalty, context, 1, seed);
+        gp.initializePopulation();
+
+        // New trees go to the arena the population doesn't live in, so it can be reset to bound memory
+        gp.activeArena = 1 - gp.activeArena;
+        auto run = [&gp](auto operation) {
+            return measure([&gp, &operation] {
+                std::size_t nodes = 0;
+                for (std::size_t i = 0 ; i < operations ; i++) {
+                    if (i % resetInterval == 0) gp.arena().reset();
+                    nodes += operation(i);
+                }
+                sink = nodes;
+            });
+        };
+        GPNode<double, Context>** population = gp.population.data();
+        std::size_t size = gp.populationSize;
+
+        printHeader("Variation (population of 500, max 7 levels and 50 nodes)");
+        report("full", operations, run([&gp](std::size_t i) {
+            return gp.full(2 + i % (gp.generator.getMaxDepthFull() - 1), gp.maxTreeNodes)->getSubtreeSize();
+        }));
+        report("grow", operations, run([&gp](std::size_t i) {
+            return gp.grow(2 + i % (gp.maxTreeDepth - 1), gp.maxTreeNodes, nullptr, true)->getSubtreeSize();
+        }));
+        report("clone", operations, run([&gp, population, size](std::size_t i) {
+            return population[i % size]->clone(gp.arena())->getSubtreeSize();
+        }));
+        report("mutate", operations, run([&gp, population, size](std::size_t i) {
+            return gp.mutate(population[i % size])->getSubtreeSize();
+        }));
+        report("cross", operations, run([&gp, population, size](std::size_t i) {
+            auto children = gp.cross(population[i % size], population[(7 * i + 1) % size]);
+            return children.first != nullptr ? children.first->getSubtreeSize() : 0;
+        }));
+        report("tournament", operations, run([&gp](std::size_t) {
+            return gp.tournament().first->getSubtreeSize();
+        }));
+
+        // Whole generations including evaluation, newGeneration manages the arenas itself
+        gp.activeArena = 1 - gp.activeArena;
+        constexpr std::size_t generations = 20;
+        report("newGeneration", generations, measure([&gp] {
+            for (std::size_t i = 0 ; i < generations ; i++) gp.newGeneration();
+        }));
+    }
+};
+
+// Penalty::calculate over random trees, the work is reported per executed instruction per sample
+template <typename T, typename Samples>
+void evaluation(const std::string& name, const Samples& samples, const std::vector<GPOperator<T, RegressionContext<T>>>& operators) {
+    using Context = RegressionContext<T>;
+    Context context = makeContext<T>(samples);
+    GPGenerator<T, Context> generator(operators, 7, 50, T(-1), T(1));
+    std::mt19937 rng(seed);
+
+    std::size_t trees = std::clamp<std::size_t>(20000000 / context.getRows(), 5, 2000);
+    std::vector<std::vector<GPGene<T, Context>>> genes(trees);
+    for (std::size_t i = 0 ; i < trees ; i++) {
+        generator.grow(genes[i], 2 + i % 6, 50, rng, true);
+    }
+
+    printHeader(name + ": " + std::to_string(context.getRows()) + " rows, " + std::to_string(context.inputs) + " inputs");
+
+    std::vector<GPProgram<T, Context>> programs(trees);
+    report("compile", trees, measure([&] {
+        for (std::size_t i = 0 ; i < trees ; i++) programs[i].compile(std::span<const GPGene<T, Context>>(genes[i]));
+    }));
+
+    RegressionPenalty<T> penalty(context.getRows());
+    std::size_t instructions = 0;
+    for (const auto& program : programs) instructions += program.size();
+    Measurement m = measure([&] {
+        double sum = 0;
+        for (auto& program : programs) sum += penalty.calculate(context, program);
+        sink = static_cast<std::size_t>(std::isfinite(sum));
+    });
+    report("Penalty::calculate", trees, m);
+
+    double work = static_cast<double>(instructions) * context.getRows();
+    std::cout << std::left << std::setw(24) << "  per instruction-sample" << std::right << std::setw(10) << instructions / trees << " instr/tree"
+              << std::fixed << std::setprecision(3) << std::setw(10) << m.seconds * 1e9 / work << " ns"
+              << std::setprecision(0) << std::setw(14) << work / m.seconds / 1e6 << " M/s\n";
+}
+
+// A primitive that isn't built in
+struct Square {
+    static constexpr const char* symbol = "sqr";
+    static constexpr std::size_t arity = 1;
+
+    template <typename T>
+    static void kernel(std::span<T> a) {
+        #pragma omp simd
+        for (std::size_t i = 0 ; i < a.size() ; i++) a[i] = a[i] * a[i];
+    }
+};
+
+// The same trees with Square as a GPOpSet kernel and as a GPFunc
+void primitives(const SampleMatrix& samples) {
+    std::vector<GPOperator<double, Context>> kernels = GPOpSet<GPAdd, GPSub, GPMul, Square, GPSin, GPConst, GPVar<0>, GPVar<1>, GPVar<2>, GPVar<3>>::operators<double, Context>();
+    std::vector<GPOperator<double, Context>> functions = kernels;
+    functions[3] = {"sqr", [](const double* args, const Context&, std::size_t) {return args[0] * args[0];}, 1};
+
+    evaluation("sqr as a GPOpSet kernel", samples, kernels);
+    evaluation("sqr as a GPFunc", samples, functions);
+}
+
+int main() {
+    SampleMatrix f2;
+    bool haveF2 = f2.load("03-GP-podaci/f2.txt");
+    GPBenchmark::variation(haveF2 ? f2 : makeSynthetic(1000));
+
+    for (const auto& file : {"f1", "f2", "f3"}) {
+        SampleMatrix samples;
+        std::string path = std::string("03-GP-podaci/") + file + ".txt";
+        if (!samples.load(path) || samples.getColumns() < 2) {
+            std::cerr << "Skipping " << path << " (not found, run from Lab2)\n";
+            continue;
+        }
+        evaluation(file, samples, makeOperators(samples.getColumns() - 1));
+    }
+
+    for (std::size_t rows = 1000 ; rows <= 1000000 ; rows *= 10) {
+        evaluation("synthetic", makeSynthetic(rows), makeOperators(4));
+    }
+
+    // The same trees in single precision
+    for (std::size_t rows = 1000 ; rows <= 1000000 ; rows *= 10) {
+        evaluation("synthetic, float", FloatSampleMatrix(makeSynthetic(rows)), makeOperators<float>(4));
+    }
+
+    primitives(makeSynthetic(100000));
+
+    return 0;
+}
\ No newline at end of file
@@ -1,9 +1,20 @@
+// g++ -std=c++20 main.cpp ../Common/SampleMatrix.cpp ../Common/ThreadPool.cpp -o main -O3 -march=native -fopenmp-simd -fno-math-errno -pthread
+
 #include "GPTree.h"
+#include "GPLinear.h"
+#include "Regression.h"
+#include "../Common/SampleMatrix.h"
+#include <thread>
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <type_traits>
 
 std::vector<std::string> split(const std::string& input, char sep) {
     std::vector<std::string> result;
@@ -19,110 +30,147 @@ std::vector<std::string> split(const std::string& input, char sep) {
     return result;
 }
 
-struct Context {
-    double x1;  // input
-    double x2;  // input
-    double y;   // expected output
-
-    double valueMin;    // min value for constants
-    double valueMax;    // max value for constants
+std::pair<bool, std::string> checkOption(char* argv[], int argc, std::string option) {
+    for (int i = 1 ; i < argc ; i++) {
+        std::string arg = argv[i];
+        if (arg == option) {
+            if (i == argc - 1) {
+                std::cerr << "Missing option argument\n";
+                exit(1);
+            }
 
-    mutable std::mt19937 rng;
-};
+            std::string opt_arg = argv[i+1];
+            return std::make_pair(true, opt_arg);
+        }
+    }
 
-double myAdd(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return children[0]->evaluate(context) + children[1]->evaluate(context);
+    return std::make_pair(false, "");
 }
 
-double mySub(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return children[0]->evaluate(context) - children[1]->evaluate(context);
-}
+struct CheckpointOptions {
+    std::string path;           // Empty disables checkpoints
+    std::size_t interval;       // Generations between two checkpoints, the final population is always saved
+    std::string resume;         // Continue the run saved here
+    std::string warmStart;      // Start a new run from the population saved here
+};
 
-double myMul(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return children[0]->evaluate(context) * children[1]->evaluate(context);
+template <typename Engine>
+void saveCheckpoint(Engine& gp, const std::string& path) {
+    if (!gp.getCheckpoint().save(path, gp.getOperators())) {
+        std::cerr << "Failed to write checkpoint: " << path << '\n';
+    }
 }
 
-double myDiv(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    double child1 = children[1]->evaluate(context);
-    if (child1 == 0) return 1.0;
-    return children[0]->evaluate(context) / child1;
+template <typename T, typename Context>
+std::vector<GPGene<T, Context>> genesOf(GPNode<T, Context>& tree) {
+    std::vector<GPGene<T, Context>> genes;
+    tree.toGenes(genes);
+    return genes;
 }
 
-double mySin(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return std::sin(children[0]->evaluate(context));
+template <typename T, typename Context>
+std::vector<GPGene<T, Context>> genesOf(GPLinearTree<T, Context>& tree) {
+    return tree.getGenes();
 }
 
-double myCos(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return std::cos(children[0]->evaluate(context));
-}
+/*
+    With -precision float the final best individual is evaluated again in double precision
+    main only uses built-in operators, so each one gets a double twin with the same opcode
+*/
+class DoubleRescore {
+    private:
+        std::unordered_map<std::string, GPOperator<double, Context>> operators;    // By symbol
+        Context context;
+        Penalty penalty;
 
-double mySqrt(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    double child1 = children[0]->evaluate(context);
-    if (child1 < 0) return 1.0;
-    return std::sqrt(child1);
-}
+    public:
+        DoubleRescore(const SampleMatrix& samples) : context(makeContext<double>(samples)), penalty(samples.getRows()) {}
+
+        template <typename Tree>
+        double calculate(Tree& tree) {
+            std::vector<GPGene<double, Context>> genes;
+            for (const auto& gene : genesOf(tree)) {
+                auto [twin, inserted] = this->operators.try_emplace(gene.oper->symbol);
+                if (inserted) twin->second = {gene.oper->symbol, nullptr, gene.oper->arity, gene.oper->opcode, gene.oper->variable};
+                genes.push_back({&twin->second, gene.subtreeSize, gene.subtreeDepth, gene.hash, static_cast<double>(gene.value)});
+            }
 
-double myLog(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    double child1 = children[0]->evaluate(context);
-    if (child1 <= 0) return 1.0;
-    return std::log10(child1);
-}
+            GPProgram<double, Context> program;
+            program.compile(std::span<const GPGene<double, Context>>(genes));
+            return this->penalty.calculate(this->context, program);
+        }
+};
 
-double myExp(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return std::exp(children[0]->evaluate(context));
-}
+template <typename Engine>
+void run(Engine& gp, std::size_t costEvaluations, const CheckpointOptions& checkpoints, DoubleRescore* rescore) {
+    if (!checkpoints.resume.empty() || !checkpoints.warmStart.empty()) {
+        const std::string& path = checkpoints.resume.empty() ? checkpoints.warmStart : checkpoints.resume;
+        decltype(gp.getCheckpoint()) checkpoint;
+        if (!checkpoint.load(path, gp.getOperators())) {
+            std::cerr << "Failed to load checkpoint " << path << " (wrong file or different operators)\n";
+            exit(1);
+        }
 
-double x1(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return context.x1;
-}
+        if (checkpoints.resume.empty()) {
+            gp.initializePopulation(checkpoint.population);
+        } else if (!gp.restore(checkpoint)) {
+            std::cerr << "Checkpoint " << path << " has a different population size\n";
+            exit(1);
+        }
+    } else {
+        gp.initializePopulation();
+    }
 
-double x2(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    return context.x2;
-}
+    for (std::size_t generation = 1 ; gp.getCostEvaluations() < costEvaluations ; generation++) {
+        std::size_t before = gp.getCostEvaluations();
+        gp.newGeneration();
+        if (!checkpoints.path.empty() && generation % checkpoints.interval == 0) saveCheckpoint(gp, checkpoints.path);
 
-double value(std::string* symbol, const std::vector<std::unique_ptr<GPNode<double, Context>>>& children, const Context& context) {
-    if (*symbol == "") {
-        std::uniform_real_distribution<double> dist(context.valueMin, context.valueMax);
-        *symbol = std::to_string(dist(context.rng));
+        // Reused duplicates don't count against the budget, so a converged population would never spend it
+        if (gp.getCostEvaluations() == before) {
+            std::cout << "Stopped after generation " << generation << ", it had no new individuals to evaluate\n";
+            break;
+        }
     }
-    return std::stod(*symbol);
-}
+    if (!checkpoints.path.empty()) saveCheckpoint(gp, checkpoints.path);
 
-class Penalty : public IPenalty<double, Context> {
-    public:
-        double calculate(std::vector<Context>& contexts, GPNode<double, Context>& tree) {
-            double penalty = 0;
+    auto& best = gp.getBestSolution();
+    std::cout << "Best penalty: " << best.getPenalty() << '\n';
+    if (rescore) std::cout << "Best penalty in double: " << rescore->calculate(best) << '\n';
+    std::cout << best.toString() << '\n';
 
-            for (const Context& context : contexts) {
-                double diff = tree.evaluate(context) - context.y;
-                penalty += (diff * diff);
-            }
+    std::cout << "Duplicates: " << gp.getDuplicates() << " reused a twin's penalty, " << gp.getRejected() << " rejected\n";
+    std::cout << "Early abort: " << gp.getAbortedEvaluations() << " of " << gp.getCostEvaluations() << " evaluations stopped at the cutoff\n";
+    std::cout << "Constant tuning: " << gp.getImprovedByTuning() << " individuals improved\n";
 
-            return std::sqrt(penalty);
-        } 
-};
+    if (const auto* cache = gp.getSubtreeCache()) {
+        std::cout << "Subtree cache: " << cache->getHitRate() * 100 << "% hit rate (" << cache->getHits() << " hits, " << cache->getMisses() << " misses), "
+                  << cache->getEntries() << " entries in " << cache->getUsedBytes() / 1024 << " KiB\n";
+    }
+}
+
+template <typename T>
+int solve(int argc, char* argv[]) {
+    using Context = RegressionContext<T>;
 
-int main() {
     std::ifstream parameters("parameters.txt");
     if (!parameters.is_open()) {
         std::cerr << "Failed to open parameters.txt\n";
         exit(1);
     }
 
-    std::unordered_map<std::string, GPOperator<double, Context>> operatorsMap = {
-        {"add", {"+", myAdd, 2}},
-        {"sub", {"-", mySub, 2}},
-        {"mul", {"*", myMul, 2}},
-        {"div", {"/", myDiv, 2}},
-        {"sin", {"sin", mySin, 1}},
-        {"cos", {"cos", myCos, 1}},
-        {"sqrt", {"sqrt", mySqrt, 1}},
-        {"log", {"log", myLog, 1}},
-        {"exp", {"exp", myExp, 1}},
-
-        {"x1", {"x1", x1, 0}},
-        {"x2", {"x2", x2, 0}},
-        {"val", {"", value, 0}}
+    std::unordered_map<std::string, GPOperator<T, Context>> operatorsMap = {
+        {"add", {"+", nullptr, 2, GPOpcode::ADD}},
+        {"sub", {"-", nullptr, 2, GPOpcode::SUB}},
+        {"mul", {"*", nullptr, 2, GPOpcode::MUL}},
+        {"div", {"/", nullptr, 2, GPOpcode::DIV}},
+        {"sin", {"sin", nullptr, 1, GPOpcode::SIN}},
+        {"cos", {"cos", nullptr, 1, GPOpcode::COS}},
+        {"sqrt", {"sqrt", nullptr, 1, GPOpcode::SQRT}},
+        {"log", {"log", nullptr, 1, GPOpcode::LOG}},
+        {"exp", {"exp", nullptr, 1, GPOpcode::EXP}},
+
+        {"val", {"C", nullptr, 0, GPOpcode::CONST}}
     };
 
     std::string line;
@@ -131,7 +179,7 @@ int main() {
     // Operators
     std::getline(parameters, line);
     parts = split(line, ' ');
-    std::vector<GPOperator<double, Context>> operators;
+    std::vector<GPOperator<T, Context>> operators;
     for (std::size_t i = 1 ; i < parts.size() ; i++) {
         operators.push_back(operatorsMap[parts[i]]);
     }
@@ -156,6 +204,11 @@ int main() {
     std::getline(parameters, line);
     parts = split(line, ' ');
     std::size_t tournamentSize = std::stoi(parts[1]);
+    // Tournaments draw distinct individuals, so a bigger one could never be filled
+    if (tournamentSize == 0 || tournamentSize > populationSize) {
+        std::cerr << "Tournament size must be between 1 and the population size (" << populationSize << ")\n";
+        exit(1);
+    }
 
     // Cost evaluations
     std::getline(parameters, line);
@@ -197,41 +250,214 @@ int main() {
     parts = split(line, ' ');
     std::string problemPath = parts[1];
 
-    std::vector<Context> contexts;
-    std::ifstream problem(problemPath);
-    std::size_t inputSize = 0;
-    while (std::getline(problem, line)) {
-        parts = split(line, '\t');
-        if (inputSize == 0) {
-            inputSize = parts.size() - 1;
-            operators.push_back(operatorsMap["x1"]);
-            if (inputSize > 1) operators.push_back(operatorsMap["x2"]);
-        }
+    SampleMatrix samples;
+    std::pair<bool, std::string> cacheOption = checkOption(argv, argc, "-cache");
+    bool loaded = cacheOption.first ? samples.load(problemPath, cacheOption.second) : samples.load(problemPath);
+    if (!loaded || samples.getColumns() < 2) {
+        std::cerr << "Failed to load " << problemPath << '\n';
+        exit(1);
+    }
 
-        Context context;
+    // Every input column becomes a terminal
+    std::size_t inputSize = samples.getColumns() - 1;
+    for (std::size_t i = 0 ; i < inputSize ; i++) {
+        std::string symbol = "x" + std::to_string(i + 1);
+        operators.push_back({symbol, nullptr, 0, GPOpcode::VAR, i});
+    }
+
+    // Float runs evaluate on a single precision copy of the samples
+    std::unique_ptr<FloatSampleMatrix> floatSamples;
+    std::unique_ptr<DoubleRescore> rescore;
+    Context context;
+    if constexpr (std::is_same_v<T, float>) {
+        floatSamples = std::make_unique<FloatSampleMatrix>(samples);
+        rescore = std::make_unique<DoubleRescore>(samples);
+        context = makeContext<T>(*floatSamples);
+    } else {
+        context = makeContext<T>(samples);
+    }
+
+    RegressionPenalty<T> penalty(context.getRows());
 
-        context.valueMin = minValue;
-        context.valueMax = maxValue;
-        context.rng.seed(std::random_device{}());
+    // -threads n evaluates offspring on n threads, -seed s makes the run reproducible (for any thread count)
+    std::pair<bool, std::string> threadsOption = checkOption(argv, argc, "-threads");
+    std::size_t threads = threadsOption.first ? std::stoul(threadsOption.second) : std::max(1u, std::thread::hardware_concurrency());
+    std::pair<bool, std::string> seedOption = checkOption(argv, argc, "-seed");
+    std::mt19937::result_type seed = seedOption.first ? std::stoul(seedOption.second) : std::random_device{}();
 
-        context.y = std::stod(parts[parts.size() - 1]);
-        context.x1 = std::stod(parts[0]);
-        if (inputSize > 1) context.x2 = std::stod(parts[1]);
+    // -subtreeCache m reuses the outputs of already evaluated subtrees, keeping at most m MiB of them
+    std::pair<bool, std::string> subtreeCacheOption = checkOption(argv, argc, "-subtreeCache");
+    std::size_t subtreeCacheBytes = subtreeCacheOption.first ? std::stoul(subtreeCacheOption.second) << 20 : 0;
 
-        contexts.push_back(context);
+    // -duplicates reuse (default) evaluates duplicate offspring only once, -duplicates reject also replaces them with new offspring
+    std::pair<bool, std::string> duplicatesOption = checkOption(argv, argc, "-duplicates");
+    if (duplicatesOption.first && duplicatesOption.second != "reuse" && duplicatesOption.second != "reject") {
+        std::cerr << "Unknown duplicates mode: " << duplicatesOption.second << '\n';
+        exit(1);
+    }
+    bool rejectDuplicates = duplicatesOption.first && duplicatesOption.second == "reject";
+
+    // -earlyAbort k stops evaluating offspring that are already worse than the k-th worst individual of the population
+    std::pair<bool, std::string> earlyAbortOption = checkOption(argv, argc, "-earlyAbort");
+    std::size_t earlyAbort = earlyAbortOption.first ? std::stoul(earlyAbortOption.second) : 0;
+
+    // -tuneConstants k tunes the constants of the k best individuals every -tuneInterval generations, with at most -tunePasses passes over the samples each
+    std::pair<bool, std::string> tuneConstantsOption = checkOption(argv, argc, "-tuneConstants");
+    std::size_t tuneConstants = tuneConstantsOption.first ? std::stoul(tuneConstantsOption.second) : 0;
+    std::pair<bool, std::string> tuneIntervalOption = checkOption(argv, argc, "-tuneInterval");
+    std::size_t tuneInterval = tuneIntervalOption.first ? std::stoul(tuneIntervalOption.second) : 1;
+    std::pair<bool, std::string> tunePassesOption = checkOption(argv, argc, "-tunePasses");
+    std::size_t tunePasses = tunePassesOption.first ? std::stoul(tunePassesOption.second) : 10;
+
+    // -replacement steadyState replaces the worst individual with every new offspring instead of building whole generations (tree genome only),
+    // offspring are evaluated in batches of 32 and with -earlyAbort the cutoff is the worst penalty of the population
+    std::pair<bool, std::string> replacementOption = checkOption(argv, argc, "-replacement");
+    if (replacementOption.first && replacementOption.second != "generational" && replacementOption.second != "steadyState") {
+        std::cerr << "Unknown replacement: " << replacementOption.second << '\n';
+        exit(1);
     }
+    bool steadyState = replacementOption.first && replacementOption.second == "steadyState";
 
-    Penalty penalty;
-    GP<double, Context> gp = GP<double, Context>(operators, populationSize, maxDepth, maxNodes, tournamentSize, elitism, pClone, pMutate, pCross, &penalty, contexts);
-    gp.initializePopulation();
-    
-    while (gp.getCostEvaluations() < costEvaluations) {
-        gp.newGeneration();
+    // -selection pareto ranks individuals by (penalty, size) before comparing penalties, which keeps trees small (generational replacement only)
+    std::pair<bool, std::string> selectionOption = checkOption(argv, argc, "-selection");
+    if (selectionOption.first && selectionOption.second != "penalty" && selectionOption.second != "pareto") {
+        std::cerr << "Unknown selection: " << selectionOption.second << '\n';
+        exit(1);
+    }
+    GPSelection selection = selectionOption.first && selectionOption.second == "pareto" ? GPSelection::PARETO : GPSelection::PENALTY;
+    if (selection == GPSelection::PARETO && steadyState) {
+        std::cerr << "Pareto selection needs generational replacement\n";
+        exit(1);
     }
 
-    auto& best = gp.getBestSolution();
-    std::cout << "Best penalty: " << best.getPenalty() << '\n';
-    std::cout << best.toString() << '\n';
+    /*
+        -islands n splits the population into n islands evolving on their own threads (tree genome only),
+        every -migrationInterval generations each island sends it's best -migrants individuals to the next one (-topology ring) or a random one (-topology random)
+    */
+    std::pair<bool, std::string> islandsOption = checkOption(argv, argc, "-islands");
+    std::size_t islands = islandsOption.first ? std::stoul(islandsOption.second) : 1;
+    std::pair<bool, std::string> migrationIntervalOption = checkOption(argv, argc, "-migrationInterval");
+    std::size_t migrationInterval = migrationIntervalOption.first ? std::stoul(migrationIntervalOption.second) : 10;
+    std::pair<bool, std::string> migrantsOption = checkOption(argv, argc, "-migrants");
+    std::size_t migrants = migrantsOption.first ? std::stoul(migrantsOption.second) : 5;
+    std::pair<bool, std::string> topologyOption = checkOption(argv, argc, "-topology");
+    GPTopology topology = GPTopology::RING;
+    if (topologyOption.first && topologyOption.second == "random") topology = GPTopology::RANDOM;
+    else if (topologyOption.first && topologyOption.second != "ring") {
+        std::cerr << "Unknown topology: " << topologyOption.second << '\n';
+        exit(1);
+    }
+
+    /*
+        -checkpoint path saves the population every -checkpointInterval generations (default 10) and at the end,
+        -resume path continues a saved run, -warmStart path starts a new run from a saved population (single population only)
+    */
+    CheckpointOptions checkpoints;
+    std::pair<bool, std::string> checkpointOption = checkOption(argv, argc, "-checkpoint");
+    if (checkpointOption.first) checkpoints.path = checkpointOption.second;
+    std::pair<bool, std::string> checkpointIntervalOption = checkOption(argv, argc, "-checkpointInterval");
+    checkpoints.interval = checkpointIntervalOption.first ? std::max(1ul, std::stoul(checkpointIntervalOption.second)) : 10;
+    std::pair<bool, std::string> resumeOption = checkOption(argv, argc, "-resume");
+    if (resumeOption.first) checkpoints.resume = resumeOption.second;
+    std::pair<bool, std::string> warmStartOption = checkOption(argv, argc, "-warmStart");
+    if (warmStartOption.first) checkpoints.warmStart = warmStartOption.second;
+
+    // -telemetry path writes best/mean/median penalty, tree sizes, phase times and allocations of every generation as CSV, or as JSON lines for a .jsonl path
+    std::unique_ptr<GPTelemetryWriter> telemetry;
+    std::pair<bool, std::string> telemetryOption = checkOption(argv, argc, "-telemetry");
+    if (telemetryOption.first) {
+        telemetry = std::make_unique<GPTelemetryWriter>(telemetryOption.second);
+        if (!telemetry->isOpen()) {
+            std::cerr << "Failed to open telemetry file: " << telemetryOption.second << '\n';
+            exit(1);
+        }
+    }
+    auto writeTelemetry = [&telemetry](const GPGenerationStats& stats) {
+        telemetry->write(stats);
+    };
+
+    // -genome tree (default) keeps individuals as linked nodes, -genome linear as prefix-order gene arrays
+    std::pair<bool, std::string> genomeOption = checkOption(argv, argc, "-genome");
+    if (genomeOption.first && genomeOption.second == "linear") {
+        if (steadyState) {
+            std::cerr << "Steady-state replacement needs the tree genome\n";
+            exit(1);
+        }
+
+        LinearGP<T, Context> gp(operators, populationSize, maxDepth, maxNodes, tournamentSize, elitism, pClone, pMutate, pCross, minValue, maxValue, &penalty, context, threads, seed);
+        if (subtreeCacheBytes != 0) gp.enableSubtreeCache(subtreeCacheBytes);
+        gp.setRejectDuplicates(rejectDuplicates);
+        gp.setEarlyAbort(earlyAbort);
+        gp.setConstantTuning(tuneConstants, tuneInterval, tunePasses);
+        gp.setSelection(selection);
+        if (telemetry) gp.setTelemetry(writeTelemetry);
+        run(gp, costEvaluations, checkpoints, rescore.get());
+    } else if (islands > 1 && (!genomeOption.first || genomeOption.second == "tree")) {
+        if (checkpointOption.first || resumeOption.first || warmStartOption.first) {
+            std::cerr << "Checkpoints need a single population\n";
+            exit(1);
+        }
+        if (telemetry) {
+            std::cerr << "Telemetry needs a single population\n";
+            exit(1);
+        }
+
+        // Every island gets an equal share of the population and it's own penalty, since they are evaluated concurrently
+        std::vector<std::unique_ptr<RegressionPenalty<T>>> islandPenalties;
+        std::vector<IPenalty<T, Context>*> penalties;
+        for (std::size_t i = 0 ; i < islands ; i++) {
+            islandPenalties.push_back(std::make_unique<RegressionPenalty<T>>(context.getRows()));
+            penalties.push_back(islandPenalties.back().get());
+        }
+
+        std::size_t islandSize = populationSize / islands;
+        if (islandSize < tournamentSize || islandSize < elitism) {
+            std::cerr << "Population is too small for " << islands << " islands\n";
+            exit(1);
+        }
+
+        GPIslands<T, Context> gp(operators, islands, islandSize, maxDepth, maxNodes, tournamentSize, elitism, pClone, pMutate, pCross, minValue, maxValue,
+                                      penalties, context, migrationInterval, migrants, topology, seed);
+        for (std::size_t i = 0 ; i < gp.size() ; i++) {
+            if (subtreeCacheBytes != 0) gp.getIsland(i).enableSubtreeCache(subtreeCacheBytes / islands);
+            gp.getIsland(i).setRejectDuplicates(rejectDuplicates);
+            gp.getIsland(i).setEarlyAbort(earlyAbort);
+            gp.getIsland(i).setConstantTuning(tuneConstants, tuneInterval, tunePasses);
+            gp.getIsland(i).setSelection(selection);
+            gp.getIsland(i).setSteadyState(steadyState);
+        }
+        gp.run(costEvaluations);
+
+        auto& best = gp.getBestSolution();
+        std::cout << "Best penalty: " << best.getPenalty() << '\n';
+        if (rescore) std::cout << "Best penalty in double: " << rescore->calculate(best) << '\n';
+        std::cout << best.toString() << '\n';
+        std::cout << "Cost evaluations: " << gp.getCostEvaluations() << " on " << gp.size() << " islands\n";
+    } else if (!genomeOption.first || genomeOption.second == "tree") {
+        GP<T, Context> gp(operators, populationSize, maxDepth, maxNodes, tournamentSize, elitism, pClone, pMutate, pCross, minValue, maxValue, &penalty, context, threads, seed);
+        if (subtreeCacheBytes != 0) gp.enableSubtreeCache(subtreeCacheBytes);
+        gp.setRejectDuplicates(rejectDuplicates);
+        gp.setEarlyAbort(earlyAbort);
+        gp.setConstantTuning(tuneConstants, tuneInterval, tunePasses);
+        gp.setSelection(selection);
+        gp.setSteadyState(steadyState);
+        if (telemetry) gp.setTelemetry(writeTelemetry);
+        run(gp, costEvaluations, checkpoints, rescore.get());
+    } else {
+        std::cerr << "Unknown genome: " << genomeOption.second << '\n';
+        exit(1);
+    }
 
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // -precision float evaluates in single precision (twice the SIMD lanes and half the memory traffic of double), the final best is re-scored in double
+    std::pair<bool, std::string> precisionOption = checkOption(argv, argc, "-precision");
+    if (precisionOption.first && precisionOption.second != "double" && precisionOption.second != "float") {
+        std::cerr << "Unknown precision: " << precisionOption.second << '\n';
+        exit(1);
+    }
+    if (precisionOption.first && precisionOption.second == "float") return solve<float>(argc, argv);
+    return solve<double>(argc, argv);
 }
\ No newline at end of file
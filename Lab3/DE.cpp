@@ -1,24 +1,7 @@
 #include "DE.h"
-#include <unordered_set>
+#include <algorithm>
 #include <iostream>
 
-std::vector<double> subtractVectors(const std::vector<double>& v1, const std::vector<double>& v2) {
-    std::vector<double> result;
-    result.reserve(v1.size());
-
-    for (std::size_t i = 0 ; i < v1.size() ; i++) {
-        result.push_back(v1[i] - v2[i]);
-    }
-
-    return result;
-}
-
-void scaleVectorAndAdd(std::vector<double>& base, const std::vector<double>& v, double scaler) {
-    for (std::size_t i = 0 ; i < base.size() ; i++) {
-        base[i] += (scaler * v[i]);
-    }
-}
-
 DE::DE(
     BaseChoice baseChoice,
     std::size_t nDifferenceVectors,
@@ -29,7 +12,9 @@ DE::DE(
     std::size_t costCalculations,
     double initPopBoundLower,
     double initPopBoundUpper,
-    ISystem* system
+    ISystem* system,
+    std::size_t threads,
+    std::mt19937::result_type seed
 ) :
     baseChoice(baseChoice),
     nDifferenceVectors(nDifferenceVectors),
@@ -38,131 +23,166 @@ DE::DE(
     vectorScaler(vectorScaler),
     populationSize(populationSize),
     costCalculations(costCalculations),
-    rng(std::random_device{}()),
+    rng(seed),
     initPopDist(initPopBoundLower, initPopBoundUpper),
     populationDist(0, populationSize - 1),
     probDist(0, 1),
     coefDist(0, system->getVectorSize() - 1),
     system(system),
     vectorSize(system->getVectorSize()),
-    population(populationSize, Unit(system->getVectorSize()))
-    {}
+    population(populationSize * system->getVectorSize()),
+    fitness(populationSize, std::numeric_limits<double>::infinity()),
+    nextPopulation(populationSize * system->getVectorSize()),
+    nextFitness(populationSize),
+    best(system->getVectorSize()),
+    pool(threads),
+    mutants(pool.size() * system->getVectorSize()),
+    chosenIndices(pool.size() * 2 * nDifferenceVectors)
+    {
+        for (std::size_t i = 0 ; i < (populationSize + blockSize - 1) / blockSize ; i++) {
+            this->streams.emplace_back(this->rng());
+        }
+    }
 
 Unit DE::getBest() const {
     return this->best;
 }
 
 void DE::initialize() {
-    for (auto& unit : this->population) {
-        for (double& x : unit.v) {
-            x = this->initPopDist(this->rng);
-        }
-        unit.fitness = this->system->getOptimizationParameter(unit.v);
-        if (unit.fitness < this->best.fitness) {
-            this->best = unit;
+    for (double& x : this->population) {
+        x = this->initPopDist(this->rng);
+    }
+    this->system->evaluateBatch(this->population, this->fitness);
+
+    for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+        if (this->fitness[i] < this->best.fitness) {
+            this->best.v.assign(this->row(this->population, i), this->row(this->population, i + 1));
+            this->best.fitness = this->fitness[i];
         }
     }
 }
 
-void DE::train(bool printNewBest) {
-    std::size_t calculations = 0;
-    while (calculations < this->costCalculations) {
-        std::vector<Unit> newPopulation;
-        newPopulation.reserve(this->populationSize);
+// Builds the trial vector for unit i into row i of nextPopulation, the distributions are copied so streams can run concurrently
+void DE::makeTrial(std::size_t i, std::mt19937& rng, std::size_t worker) {
+    std::uniform_int_distribution<std::size_t> populationDist = this->populationDist;
+    std::uniform_real_distribution<double> probDist = this->probDist;
+    std::uniform_int_distribution<std::size_t> coefDist = this->coefDist;
 
-        Unit newBest = this->best;
+    const double* orig = this->row(this->population, i);
+    double* mutant = this->mutants.data() + worker * this->vectorSize;
+    double* trial = this->nextPopulation.data() + i * this->vectorSize;
 
-        for (std::size_t i = 0 ; i < this->populationSize ; i++) {
-            Unit& orig = this->population[i];
-            std::vector<double> mutant;
-
-            switch (this->baseChoice) {
-                case BaseChoice::RAND:
-                    mutant = this->population[this->populationDist(rng)].v;
-                    break;
-
-                case BaseChoice::BEST:
-                    mutant = this->best.v;
-                    break;
-
-                case BaseChoice::TARGET_TO_BEST:
-                    mutant = orig.v;
-                    std::vector<double> diff = subtractVectors(this->best.v, orig.v);
-                    scaleVectorAndAdd(mutant, diff, this->vectorScaler);
-                    break;
-            }
+    switch (this->baseChoice) {
+        case BaseChoice::RAND:
+            std::copy_n(this->row(this->population, populationDist(rng)), this->vectorSize, mutant);
+            break;
 
-            // nDifferenceVectors will usually be small so this is a valid approach
-            // If it were large then we would opt for a population (indices) shuffle
-            std::unordered_set<std::size_t> chosenIndices;
-            while (chosenIndices.size() < 2 * this->nDifferenceVectors) {
-                std::size_t index = this->populationDist(this->rng);
-                if (index != i) {
-                    chosenIndices.insert(index);
-                }
-            }
+        case BaseChoice::BEST:
+            std::copy_n(this->best.v.data(), this->vectorSize, mutant);
+            break;
 
-            auto it = chosenIndices.begin();
-            std::vector<double> sum(this->vectorSize);
-            for (std::size_t j = 0 ; j < 2 * this->nDifferenceVectors ; j+=2) {
-                std::vector<double> diff = subtractVectors(this->population[*it].v, this->population[*(++it)].v);
-                
-                for (std::size_t k = 0 ; k < sum.size() ; k++) {
-                    sum[k] += diff[k];
-                }
+        case BaseChoice::TARGET_TO_BEST:
+            for (std::size_t k = 0 ; k < this->vectorSize ; k++) {
+                mutant[k] = orig[k] + this->vectorScaler * (this->best.v[k] - orig[k]);
             }
+            break;
+    }
 
-            scaleVectorAndAdd(mutant, sum, this->vectorScaler);
-
-            Unit trial = orig;
-
-            switch (this->crossChoice) {
-                case CrossChoice::EXP: {
-                    std::size_t start = this->coefDist(this->rng);
-                    trial.v[start] = mutant[start]; // One is guaranteed to be copied from the mutant
-
-                    for (std::size_t j = start + 1 ; j != start ; j++) {
-                        if (j == trial.v.size()) {
-                            j = 0;
-                            if (start == 0) break;
-                        }
-                        
-                        if (this->probDist(this->rng) < this->mutantProbability) {
-                            trial.v[j] = mutant[j];
-                        } else break;
-                    }
-                    break;
+    // nDifferenceVectors will usually be small so checking the indices chosen so far is a valid approach
+    // If it were large then we would opt for a population (indices) shuffle
+    std::size_t* chosen = this->chosenIndices.data() + worker * 2 * this->nDifferenceVectors;
+    for (std::size_t count = 0 ; count < 2 * this->nDifferenceVectors ; ) {
+        std::size_t index = populationDist(rng);
+        if (index != i && std::find(chosen, chosen + count, index) == chosen + count) {
+            chosen[count++] = index;
+        }
+    }
+
+    for (std::size_t k = 0 ; k < this->vectorSize ; k++) {
+        double sum = 0;
+        for (std::size_t j = 0 ; j < 2 * this->nDifferenceVectors ; j+=2) {
+            sum += this->row(this->population, chosen[j])[k] - this->row(this->population, chosen[j + 1])[k];
+        }
+        mutant[k] += (this->vectorScaler * sum);
+    }
+
+    std::copy_n(orig, this->vectorSize, trial);
+
+    switch (this->crossChoice) {
+        case CrossChoice::EXP: {
+            std::size_t start = coefDist(rng);
+            trial[start] = mutant[start]; // One is guaranteed to be copied from the mutant
+
+            for (std::size_t j = start + 1 ; j != start ; j++) {
+                if (j == this->vectorSize) {
+                    j = 0;
+                    if (start == 0) break;
                 }
 
-                case CrossChoice::BIN: {
-                    std::size_t guaranteed = this->coefDist(this->rng);
-                    trial.v[guaranteed] = mutant[guaranteed]; // One is guaranteed to be copied from the mutant
-                    for (std::size_t j = 0 ; j < trial.v.size() ; j++) {
-                        if (this->probDist(this->rng) < this->mutantProbability) {
-                            trial.v[j] = mutant[j];
-                        }
-                    }
-                    break;
+                if (probDist(rng) < this->mutantProbability) {
+                    trial[j] = mutant[j];
+                } else break;
+            }
+            break;
+        }
+
+        case CrossChoice::BIN: {
+            std::size_t guaranteed = coefDist(rng);
+            trial[guaranteed] = mutant[guaranteed]; // One is guaranteed to be copied from the mutant
+            for (std::size_t j = 0 ; j < this->vectorSize ; j++) {
+                if (probDist(rng) < this->mutantProbability) {
+                    trial[j] = mutant[j];
                 }
             }
+            break;
+        }
+    }
+}
 
-            trial.fitness = this->system->getOptimizationParameter(trial.v);
-            calculations++;
-            if (trial.fitness <= orig.fitness) {
-                newPopulation.push_back(trial);
-                if (trial.fitness <= newBest.fitness) {
-                    newBest = trial;
+void DE::train(bool printNewBest) {
+    std::size_t calculations = 0;
+    while (calculations < this->costCalculations) {
+        // Trials only read the previous population and best, every block draws from it's own stream so the result doesn't depend on the number of threads
+        this->pool.parallelFor(this->streams.size(), [this](std::size_t block, std::size_t worker) {
+            std::size_t first = block * blockSize;
+            std::size_t count = std::min(blockSize, this->populationSize - first);
+            for (std::size_t i = first ; i < first + count ; i++) {
+                this->makeTrial(i, this->streams[block], worker);
+            }
+            this->system->evaluateBatch(
+                std::span<const double>(this->nextPopulation).subspan(first * this->vectorSize, count * this->vectorSize),
+                std::span<double>(this->nextFitness).subspan(first, count)
+            );
+        });
+        calculations += this->populationSize;
+
+        // Selection goes in index order, so the new best and the printing are the same for any number of threads
+        std::size_t newBest = this->populationSize;
+        double newBestFitness = this->best.fitness;
+        for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+            if (this->nextFitness[i] <= this->fitness[i]) {
+                if (this->nextFitness[i] <= newBestFitness) {
+                    newBest = i;
+                    newBestFitness = this->nextFitness[i];
                 }
             } else {
-                newPopulation.push_back(orig);
+                std::copy_n(this->row(this->population, i), this->vectorSize, this->nextPopulation.data() + i * this->vectorSize);
+                this->nextFitness[i] = this->fitness[i];
             }
         }
 
-        if (printNewBest && newBest != this->best) {
-            std::cout << "Calculations: " << calculations << " | New best: " << newBest << '\n';
-        }
+        this->population.swap(this->nextPopulation);
+        this->fitness.swap(this->nextFitness);
+
+        if (newBest != this->populationSize) {
+            const double* v = this->row(this->population, newBest);
+            bool changed = newBestFitness != this->best.fitness || !std::equal(v, v + this->vectorSize, this->best.v.begin());
+            std::copy_n(v, this->vectorSize, this->best.v.begin());
+            this->best.fitness = newBestFitness;
 
-        this->population = newPopulation;
-        this->best = newBest;
+            if (printNewBest && changed) {
+                std::cout << "Calculations: " << calculations << " | New best: " << this->best << '\n';
+            }
+        }
     }
 }
\ No newline at end of file
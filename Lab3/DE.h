@@ -1,5 +1,6 @@
 #pragma once
 #include "ISystem.h"
+#include "../Common/ThreadPool.h"
 #include <random>
 #include <limits>
 #include <iostream>
@@ -43,6 +44,8 @@ enum CrossChoice {
 
 class DE {
     private:
+        static constexpr std::size_t blockSize = 64; // Trials per task of the thread pool, each block has it's own random stream
+
         BaseChoice baseChoice;
         std::size_t nDifferenceVectors; // Vectors for creating the mutant (will choose 2 * n units)
         CrossChoice crossChoice;
@@ -58,11 +61,27 @@ class DE {
         std::uniform_int_distribution<std::size_t> coefDist; // [0, vectorSize - 1]
 
         ISystem* system;
-        std::size_t vectorSize; // Size of the Unit.v vectors (number of coefficients)
+        std::size_t vectorSize; // Number of coefficients
 
-        std::vector<Unit> population;
+        // populationSize rows of vectorSize coefficients each, row i of population is unit i
+        // Trials are built in nextPopulation, rejected ones are overwritten by their parent and the two are swapped after every generation
+        std::vector<double> population;
+        std::vector<double> fitness;
+        std::vector<double> nextPopulation;
+        std::vector<double> nextFitness;
         Unit best;
 
+        ThreadPool pool;
+        std::vector<std::mt19937> streams; // One per block of trials, seeded from rng
+
+        // Scratch space of every worker of the pool, so a generation doesn't allocate
+        std::vector<double> mutants; // One row each
+        std::vector<std::size_t> chosenIndices; // 2 * nDifferenceVectors each
+
+        const double* row(const std::vector<double>& matrix, std::size_t i) const {return matrix.data() + i * this->vectorSize;}
+
+        void makeTrial(std::size_t i, std::mt19937& rng, std::size_t worker);
+
     public:
         DE(
             BaseChoice baseChoice,
@@ -74,7 +93,9 @@ class DE {
             std::size_t costCalculations,
             double initPopBoundLower,
             double initPopBoundUpper,
-            ISystem* system
+            ISystem* system,
+            std::size_t threads = 1,
+            std::mt19937::result_type seed = std::random_device{}()
         );
 
         Unit getBest() const;
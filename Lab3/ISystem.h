@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <cstddef>
+#include <span>
+#include <algorithm>
 
 class ISystem {
     protected:
@@ -11,4 +13,14 @@ class ISystem {
         virtual ~ISystem() = default;
         std::size_t getVectorSize() const {return vectorSize;}
         virtual double getOptimizationParameter(const std::vector<double>& coef) const = 0;
+
+        // Candidates are stored one after another (fitnesses.size() rows of vectorSize coefficients), by default each one goes through getOptimizationParameter
+        // DE calls it from several threads at once for disjoint parts of a generation
+        virtual void evaluateBatch(std::span<const double> candidates, std::span<double> fitnesses) const {
+            std::vector<double> coef(vectorSize);
+            for (std::size_t i = 0 ; i < fitnesses.size() ; i++) {
+                std::copy(candidates.begin() + i * vectorSize, candidates.begin() + (i + 1) * vectorSize, coef.begin());
+                fitnesses[i] = this->getOptimizationParameter(coef);
+            }
+        }
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "PSO.h"
+#include <algorithm>
 #include <iostream>
 
 PSO::PSO(
@@ -36,7 +37,11 @@ Particle PSO::getBest() const {
 }
 
 void PSO::initialize() {
-    for (Particle& p : this->population) {
+    std::vector<double> candidates(this->populationSize * this->vectorSize);
+    std::vector<double> fitnesses(this->populationSize);
+
+    for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+        Particle& p = this->population[i];
         for (double& x : p.position) {
             x = this->initPosDist(this->rng);
         }
@@ -45,8 +50,15 @@ void PSO::initialize() {
             v = this->initVelDist(this->rng);
         }
 
+        std::copy(p.position.begin(), p.position.end(), candidates.begin() + i * this->vectorSize);
+    }
+
+    this->system->evaluateBatch(candidates, fitnesses);
+
+    for (std::size_t i = 0 ; i < this->populationSize ; i++) {
+        Particle& p = this->population[i];
         p.personalBestPosition = p.position;
-        p.personalBestFitness = this->system->getOptimizationParameter(p.position);
+        p.personalBestFitness = fitnesses[i];
     }
 
     for (Particle& p : this->population) {
@@ -88,8 +100,14 @@ void PSO::initialize() {
 
 void PSO::train(bool printNewBest) {
     std::size_t calculations = 0;
+
+    // The swarm moves synchronously, every particle steers by the bests of the previous iteration and the new positions are evaluated in one batch
+    std::vector<double> candidates(this->populationSize * this->vectorSize);
+    std::vector<double> fitnesses(this->populationSize);
+
     while (calculations < this->costCalculations) {
-        for (Particle& p : this->population) {
+        for (std::size_t j = 0 ; j < this->populationSize ; j++) {
+            Particle& p = this->population[j];
             std::vector<double> localBest;
             if (this->neighborhood == Neighborhood::GLOBAL) localBest = this->bestPosition;
             else localBest = p.localBestPosition;
@@ -104,9 +122,16 @@ void PSO::train(bool printNewBest) {
                 p.position[i] += p.velocity[i];
             }
 
-            double fitness = this->system->getOptimizationParameter(p.position);
+            std::copy(p.position.begin(), p.position.end(), candidates.begin() + j * this->vectorSize);
+        }
+
+        this->system->evaluateBatch(candidates, fitnesses);
+
+        for (std::size_t j = 0 ; j < this->populationSize ; j++) {
+            Particle& p = this->population[j];
+            double fitness = fitnesses[j];
             calculations++;
-            
+
             if (fitness < p.personalBestFitness) {
                 p.personalBestFitness = fitness;
                 p.personalBestPosition = p.position;
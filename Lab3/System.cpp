@@ -1,37 +1,72 @@
 #include "System.h"
+#include "../Common/VectorMath.h"
+#include <algorithm>
 #include <cmath>
 
-// The vector argument takes x1, x2, x3, x4, x5 and the convertion to the Sample struct will be done in the constructor
-System::System(std::size_t vectorSize, const std::vector<std::vector<double>>& samples) :
+// The matrix argument has columns x1, x2, x3, x4, x5, y and the convertion to the SampleColumn layout will be done in the constructor
+System::System(std::size_t vectorSize, const SampleMatrix& samples) :
     ISystem(vectorSize),
     samples([&] {
-        std::vector<Sample> tmp;
-        tmp.reserve(samples.size());
-
-        for (const auto& sample : samples) {
-            tmp.push_back({
-                sample[0],
-                sample[0] * sample[0] * sample[0],
-                sample[1],
-                sample[2],
-                sample[3],
-                sample[4] * sample[4],
-                sample[5]
-            });
+        SampleMatrix tmp(samples.getRows(), SAMPLE_COLUMNS);
+
+        for (std::size_t i = 0 ; i < samples.getRows() ; i++) {
+            double x1 = samples.at(i, 0);
+            double x5 = samples.at(i, 4);
+            tmp.at(i, X1) = x1;
+            tmp.at(i, X1_CUBED) = x1 * x1 * x1;
+            tmp.at(i, X2) = samples.at(i, 1);
+            tmp.at(i, X3) = samples.at(i, 2);
+            tmp.at(i, X4) = samples.at(i, 3);
+            tmp.at(i, X5_SQUARED) = x5 * x5;
+            tmp.at(i, Y) = samples.at(i, 5);
         }
 
         return tmp;
-    }()) {}
+    }()) {
+    for (std::size_t i = 0 ; i < this->samples.getRows() ; i++) {
+        this->maxX3 = std::max(this->maxX3, std::abs(this->samples.at(i, X3)));
+        this->maxX4 = std::max(this->maxX4, std::abs(this->samples.at(i, X4)));
+    }
+}
 
 // Returns the mean squares error
 double System::getOptimizationParameter(const std::vector<double>& coef) const {
+    return this->evaluate(coef.data());
+}
+
+void System::evaluateBatch(std::span<const double> candidates, std::span<double> fitnesses) const {
+    for (std::size_t i = 0 ; i < fitnesses.size() ; i++) {
+        fitnesses[i] = this->evaluate(candidates.data() + i * this->vectorSize);
+    }
+}
+
+double System::evaluate(const double* coef) const {
     double a = coef[0], b = coef[1], c = coef[2], d = coef[3], e = coef[4], f = coef[5];
+    const double* x1 = samples.column(X1);
+    const double* x1c = samples.column(X1_CUBED);
+    const double* x2 = samples.column(X2);
+    const double* x3 = samples.column(X3);
+    const double* x4 = samples.column(X4);
+    const double* x5s = samples.column(X5_SQUARED);
+    const double* y = samples.column(Y);
+
     double error = 0.0;
-    for (const Sample& sample : samples) {
-        double x1 = sample.x1, x1c = sample.x1Cubed, x2 = sample.x2, x3 = sample.x3, x4 = sample.x4, x5s = sample.x5Squared, y = sample.y;
-        double output = a * x1 + b * x1c * x2 + c * std::exp(d * x3) * (1 + std::cos(e * x4)) + f * x4 * x5s;
-        double diff = output - y;
+
+    // The negated comparisons also send NaN coefficients to the std functions
+    if (!(std::abs(d) * this->maxX3 <= VectorMath::expLimit) || !(std::abs(e) * this->maxX4 <= VectorMath::trigLimit)) {
+        for (std::size_t i = 0 ; i < samples.getRows() ; i++) {
+            double output = a * x1[i] + b * x1c[i] * x2[i] + c * std::exp(d * x3[i]) * (1 + std::cos(e * x4[i])) + f * x4[i] * x5s[i];
+            double diff = output - y[i];
+            error += (diff * diff);
+        }
+        return error;
+    }
+
+    #pragma omp simd reduction(+:error)
+    for (std::size_t i = 0 ; i < samples.getRows() ; i++) {
+        double output = a * x1[i] + b * x1c[i] * x2[i] + c * VectorMath::exp(d * x3[i]) * (1 + VectorMath::cos(e * x4[i])) + f * x4[i] * x5s[i];
+        double diff = output - y[i];
         error += (diff * diff);
     }
     return error;
-} 
\ No newline at end of file
+}
\ No newline at end of file
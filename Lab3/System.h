@@ -1,24 +1,36 @@
 #pragma once
 #include "ISystem.h"
+#include "../Common/SampleMatrix.h"
 
-struct Sample {
-    double x1;
-    double x1Cubed;
-    double x2;
-    double x3;
-    double x4;
-    double x5Squared;
-    double y;
+// Columns of the precomputed sample matrix
+enum SampleColumn {
+    X1,
+    X1_CUBED,
+    X2,
+    X3,
+    X4,
+    X5_SQUARED,
+    Y,
+    SAMPLE_COLUMNS
 };
 
 class System : public ISystem {
     private:
-        const std::vector<Sample> samples;
+        const SampleMatrix samples;
+
+        // Largest |x3| and |x4|, they bound the arguments of exp and cos for given coefficients d and e
+        double maxX3 = 0.0;
+        double maxX4 = 0.0;
+
+        double evaluate(const double* coef) const;
 
     public:
-        // The vector argument takes x1, x2, x3, x4, x5 and the convertion to the Sample struct will be done in the constructor
-        System(std::size_t vectorSize, const std::vector<std::vector<double>>& samples);
+        // The matrix argument has columns x1, x2, x3, x4, x5, y and the convertion to the SampleColumn layout will be done in the constructor
+        System(std::size_t vectorSize, const SampleMatrix& samples);
 
         // Returns the mean squares error
         double getOptimizationParameter(const std::vector<double>& coef) const override;
+
+        // Every candidate goes through the same vectorised loop over the samples as getOptimizationParameter
+        void evaluateBatch(std::span<const double> candidates, std::span<double> fitnesses) const override;
 };
\ No newline at end of file
@@ -1,9 +1,11 @@
-// g++ main.cpp DE.cpp System.cpp -o main -g -O3
+// g++ -std=c++20 main.cpp DE.cpp PSO.cpp System.cpp ../Common/SampleMatrix.cpp ../Common/ThreadPool.cpp -o main -g -O3 -march=native -fopenmp-simd -fno-math-errno -pthread
 
 #include "DE.h"
 #include "PSO.h"
 #include "System.h"
 #include <fstream>
+#include <algorithm>
+#include <thread>
 #include <sstream>
 
 std::vector<std::string> split(const std::string& input, char sep) {
@@ -20,45 +22,48 @@ std::vector<std::string> split(const std::string& input, char sep) {
     return result;
 }
 
-int main() {
-    std::ifstream dataFile("data.txt");
-    if (!dataFile.is_open()) {
-        std::cerr << "Error opening file: \"data.txt\"";
-        return 1;
+std::pair<bool, std::string> checkOption(char* argv[], int argc, std::string option) {
+    for (int i = 1 ; i < argc ; i++) {
+        std::string arg = argv[i];
+        if (arg == option) {
+            if (i == argc - 1) {
+                std::cerr << "Missing option argument\n";
+                exit(1);
+            }
+
+            std::string opt_arg = argv[i+1];
+            return std::make_pair(true, opt_arg);
+        }
     }
 
-    std::vector<std::vector<double>> data;
-    std::string line;
-
-    while (std::getline(dataFile, line)) {
-        std::vector<double> row;
-        std::string cleaned;
+    return std::make_pair(false, "");
+}
 
-        for (char c : line) {
-            if (c != '[' && c != ']' && c != ',') cleaned += c;
-        }
+int main(int argc, char* argv[]) {
+    std::pair<bool, std::string> cacheOption = checkOption(argv, argc, "-cache");
 
-        std::stringstream ss(cleaned);
-        double val;
-        while (ss >> val) {
-            row.push_back(val);
-        }
-        
-        if (!row.empty()) {
-            data.push_back(row);
-        }
+    SampleMatrix data;
+    bool loaded = cacheOption.first ? data.load("data.txt", cacheOption.second) : data.load("data.txt");
+    if (!loaded) {
+        std::cerr << "Error opening file: \"data.txt\"";
+        return 1;
     }
 
-    dataFile.close();
-
     System system = System(6, data);
 
+    // -threads n builds and evaluates DE trials on n threads, -seed s makes a DE run reproducible (for any thread count)
+    std::pair<bool, std::string> threadsOption = checkOption(argv, argc, "-threads");
+    std::size_t threads = threadsOption.first ? std::stoul(threadsOption.second) : std::max(1u, std::thread::hardware_concurrency());
+    std::pair<bool, std::string> seedOption = checkOption(argv, argc, "-seed");
+    std::mt19937::result_type seed = seedOption.first ? std::stoul(seedOption.second) : std::random_device{}();
+
     std::ifstream configFile("config.txt");
     if (!configFile.is_open()) {
         std::cerr << "Error opening file: \"config.txt\"";
         return 1;
     }
 
+    std::string line;
     std::string algorithm;
     BaseChoice baseChoice;
     std::size_t nDifferenceVectors;
@@ -142,7 +147,7 @@ int main() {
     initPopBoundUpper = std::stod(parts[1]);
 
     if (algorithm == "DE") {
-        DE de = DE(baseChoice, nDifferenceVectors, crossChoice, mutantProbability, vectorScaler, populationSize, costCalculations, initPopBoundLower, initPopBoundUpper, &system);
+        DE de = DE(baseChoice, nDifferenceVectors, crossChoice, mutantProbability, vectorScaler, populationSize, costCalculations, initPopBoundLower, initPopBoundUpper, &system, threads, seed);
         de.initialize();
         std::cout << "Initial best: " << de.getBest() << '\n';
         de.train(true);